@@ -1,34 +1,82 @@
 #include <algorithm>
+#include <stdexcept>
 #include "image.h"
 
-uint8_t clamp(float value) {
-  return (uint8_t) (std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
-}
-
-ppgso::Image::Image(int width, int height) : width{width}, height{height} {
+template<typename Format>
+ppgso::BasicImage<Format>::BasicImage(int width, int height) : width{width}, height{height} {
   framebuffer.resize((size_t) (width * height));
 }
 
-std::vector<ppgso::Image::Pixel>& ppgso::Image::getFramebuffer() {
+template<typename Format>
+typename ppgso::BasicImage<Format>::Framebuffer& ppgso::BasicImage<Format>::getFramebuffer() {
   return framebuffer;
 }
 
-ppgso::Image::Pixel& ppgso::Image::getPixel(int x, int y) {
+template<typename Format>
+typename ppgso::BasicImage<Format>::Pixel& ppgso::BasicImage<Format>::getPixel(int x, int y) {
   return framebuffer[x+y*width];
 }
 
-void ppgso::Image::setPixel(int x, int y, const Image::Pixel& color) {
+template<typename Format>
+void ppgso::BasicImage<Format>::setPixel(int x, int y, const Pixel& color) {
   framebuffer[x+y*width] = color;
 }
 
-void ppgso::Image::clear(const ppgso::Image::Pixel &color) {
-  framebuffer = std::vector<Pixel>(framebuffer.size(), color);
+template<typename Format>
+void ppgso::BasicImage<Format>::clear(const Pixel &color) {
+  fill(0, 0, width, height, color);
+}
+
+template<typename Format>
+void ppgso::BasicImage<Format>::fill(int x, int y, int width, int height, const Pixel &color) {
+  // Clip the rectangle to the image
+  int x0 = std::max(x, 0), y0 = std::max(y, 0);
+  int x1 = std::min(x + width, this->width), y1 = std::min(y + height, this->height);
+  if (x0 >= x1 || y0 >= y1) return;
+
+  // Only the first row is filled pixel by pixel, the remaining rows are copied from it in bulk
+  auto first = &framebuffer[x0 + y0 * this->width];
+  std::fill_n(first, x1 - x0, color);
+  for (int row = y0 + 1; row < y1; row++)
+    std::copy_n(first, x1 - x0, &framebuffer[x0 + row * this->width]);
 }
 
-void ppgso::Image::setPixel(int x, int y, int r, int g, int b) {
-  setPixel(x,y,{(uint8_t)r, (uint8_t)g, (uint8_t)b});
+template<typename Format>
+void ppgso::BasicImage<Format>::copy(BasicImage &source) {
+  if (source.width != width || source.height != height)
+    throw std::runtime_error{"Copied images must have the same size"};
+  std::copy(source.framebuffer.begin(), source.framebuffer.end(), framebuffer.begin());
 }
 
-void ppgso::Image::setPixel(int x, int y, float r, float g, float b) {
-  setPixel(x,y,{clamp(r), clamp(g), clamp(b)});
+template<typename Format>
+void ppgso::BasicImage<Format>::blit(BasicImage &source, int sourceX, int sourceY, int width, int height, int x, int y) {
+  // Clip the rectangle to the source image, then to this image
+  if (sourceX < 0) { width += sourceX; x -= sourceX; sourceX = 0; }
+  if (sourceY < 0) { height += sourceY; y -= sourceY; sourceY = 0; }
+  if (x < 0) { width += x; sourceX -= x; x = 0; }
+  if (y < 0) { height += y; sourceY -= y; y = 0; }
+  width = std::min({width, source.width - sourceX, this->width - x});
+  height = std::min({height, source.height - sourceY, this->height - y});
+  if (width <= 0 || height <= 0) return;
+
+  for (int row = 0; row < height; row++)
+    std::copy_n(&source.framebuffer[sourceX + (sourceY + row) * source.width], width,
+                &framebuffer[x + (y + row) * this->width]);
 }
+
+template<typename Format>
+void ppgso::BasicImage<Format>::setPixel(int x, int y, int r, int g, int b) {
+  setPixel(x, y, Format::fromColor(glm::vec4{r, g, b, 255} / 255.0f));
+}
+
+template<typename Format>
+void ppgso::BasicImage<Format>::setPixel(int x, int y, float r, float g, float b) {
+  setPixel(x, y, Format::fromColor({r, g, b, 1.0f}));
+}
+
+// Images of all supported formats
+template class ppgso::BasicImage<ppgso::format::RGB8>;
+template class ppgso::BasicImage<ppgso::format::RGBA8>;
+template class ppgso::BasicImage<ppgso::format::R32F>;
+template class ppgso::BasicImage<ppgso::format::RGB32F>;
+template class ppgso::BasicImage<ppgso::format::Depth32F>;
@@ -1,16 +1,158 @@
 #pragma once
+#include <cstdint>
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <memory>
 #include <fstream>
+#include <new>
+#include <stdexcept>
+#include <glm/glm.hpp>
 
 namespace ppgso {
 
-  class Image {
-  public:
-    struct Pixel {
-      uint8_t r, g, b;
+  /*!
+   * Allocator for framebuffers, storage starts at a cache line boundary so rows of pixels can be loaded with aligned SIMD loads.
+   */
+  template<typename T, size_t Alignment = 64>
+  struct AlignedAllocator {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+      using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate(size_t count) {
+      // Over-allocate and keep the original pointer right before the aligned storage
+      void *memory = std::malloc(count * sizeof(T) + Alignment + sizeof(void *));
+      if (!memory) throw std::bad_alloc{};
+      auto address = (reinterpret_cast<uintptr_t>(memory) + sizeof(void *) + Alignment - 1) & ~(uintptr_t) (Alignment - 1);
+      reinterpret_cast<void **>(address)[-1] = memory;
+      return reinterpret_cast<T *>(address);
+    }
+
+    void deallocate(T *pointer, size_t) {
+      if (pointer) std::free(reinterpret_cast<void **>(pointer)[-1]);
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const {
+      return true;
+    }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const {
+      return false;
+    }
+  };
+
+  /*!
+   * Pixel formats of images, each format defines its pixel type and conversions from and to normalized RGBA colors.
+   */
+  namespace format {
+    /*!
+     * 8bit RGB color, the byte layout matches the RGB data of BMP, RAW files and OpenGL textures.
+     */
+    struct RGB8 {
+      struct Pixel {
+        uint8_t r, g, b;
+      };
+      static const int CHANNELS = 3;
+
+      static glm::vec4 toColor(const Pixel &pixel) {
+        return glm::vec4{pixel.r, pixel.g, pixel.b, 255} / 255.0f;
+      }
+
+      static Pixel fromColor(const glm::vec4 &color) {
+        auto c = glm::clamp(color, 0.0f, 1.0f) * 255.0f;
+        return {(uint8_t) c.r, (uint8_t) c.g, (uint8_t) c.b};
+      }
+    };
+
+    /*!
+     * 8bit RGB color with alpha, a pixel is a single 32bit word.
+     */
+    struct RGBA8 {
+      struct Pixel {
+        uint8_t r, g, b, a;
+      };
+      static const int CHANNELS = 4;
+
+      static glm::vec4 toColor(const Pixel &pixel) {
+        return glm::vec4{pixel.r, pixel.g, pixel.b, pixel.a} / 255.0f;
+      }
+
+      static Pixel fromColor(const glm::vec4 &color) {
+        auto c = glm::clamp(color, 0.0f, 1.0f) * 255.0f;
+        return {(uint8_t) c.r, (uint8_t) c.g, (uint8_t) c.b, (uint8_t) c.a};
+      }
+    };
+
+    /*!
+     * Single float channel, converted from the red channel of colors.
+     */
+    struct R32F {
+      using Pixel = float;
+      static const int CHANNELS = 1;
+
+      static glm::vec4 toColor(const Pixel &pixel) {
+        return {pixel, pixel, pixel, 1.0f};
+      }
+
+      static Pixel fromColor(const glm::vec4 &color) {
+        return color.r;
+      }
+    };
+
+    /*!
+     * Float RGB color without any limits, used to accumulate samples and for high dynamic range.
+     */
+    struct RGB32F {
+      using Pixel = glm::vec3;
+      static const int CHANNELS = 3;
+
+      static glm::vec4 toColor(const Pixel &pixel) {
+        return {pixel, 1.0f};
+      }
+
+      static Pixel fromColor(const glm::vec4 &color) {
+        return glm::vec3{color};
+      }
+    };
+
+    /*!
+     * Float depth, smaller values are nearer.
+     */
+    struct Depth32F {
+      using Pixel = float;
+      static const int CHANNELS = 1;
+
+      static glm::vec4 toColor(const Pixel &pixel) {
+        return {pixel, pixel, pixel, 1.0f};
+      }
+
+      static Pixel fromColor(const glm::vec4 &color) {
+        return color.r;
+      }
     };
+  }
+
+  /*!
+   * Image with pixels of a format stored by rows in an aligned framebuffer.
+   *
+   * @tparam Format - Pixel format, see the ppgso::format namespace.
+   */
+  template<typename Format>
+  class BasicImage {
+  public:
+    using Pixel = typename Format::Pixel;
+    using Framebuffer = std::vector<Pixel, AlignedAllocator<Pixel>>;
 
     /*!
      * Create new empty image.
@@ -18,14 +160,14 @@ namespace ppgso {
      * @param width - Width in pixels.
      * @param height - Height in pixels.
      */
-    Image(int width, int height);
+    BasicImage(int width, int height);
 
     /*!
      * Get raw access to the image data.
      *
-     * @return - Pointer to the raw RGB framebuffer data.
+     * @return - Reference to the framebuffer with pixels stored by rows.
      */
-    std::vector<Pixel>& getFramebuffer();
+    Framebuffer& getFramebuffer();
 
     /*!
      * Get single pixel from the framebuffer.
@@ -65,14 +207,162 @@ namespace ppgso {
     void setPixel(int x, int y, float r, float g, float b);
 
     /*!
-     * Clear the image using single color
+     * Clear the image using single color, the framebuffer is filled in place without reallocation
      * @param color Pixel color to set the image to
      */
-    void clear(const Pixel& color = {0,0,0});
+    void clear(const Pixel& color = Pixel{});
+
+    /*!
+     * Fill a rectangle with a single color, the rectangle is clipped to the image.
+     *
+     * @param x - Horizontal position of the top left corner.
+     * @param y - Vertical position of the top left corner.
+     * @param width - Width of the rectangle in pixels.
+     * @param height - Height of the rectangle in pixels.
+     * @param color - Pixel color to fill the rectangle with.
+     */
+    void fill(int x, int y, int width, int height, const Pixel& color);
+
+    /*!
+     * Copy all pixels from another image of the same size.
+     *
+     * @param source - Image to copy from.
+     */
+    void copy(BasicImage &source);
+
+    /*!
+     * Copy a rectangle of pixels from another image, the rectangle is clipped to both images.
+     *
+     * @param source - Image to copy from, must not be this image.
+     * @param sourceX - Horizontal position of the rectangle in the source image.
+     * @param sourceY - Vertical position of the rectangle in the source image.
+     * @param width - Width of the rectangle in pixels.
+     * @param height - Height of the rectangle in pixels.
+     * @param x - Horizontal position of the rectangle in this image.
+     * @param y - Vertical position of the rectangle in this image.
+     */
+    void blit(BasicImage &source, int sourceX, int sourceY, int width, int height, int x, int y);
 
     int width, height;
   private:
-    std::vector<Pixel> framebuffer;
+    Framebuffer framebuffer;
   };
-}
 
+  /*!
+   * Non-owning view of a rectangle of pixels, rows are stride pixels apart.
+   * Views of sub-rectangles and bands share the pixels of the viewed image so tiles of a frame can be processed without copies.
+   *
+   * @tparam Format - Pixel format, see the ppgso::format namespace.
+   */
+  template<typename Format>
+  class BasicImageView {
+  public:
+    using Pixel = typename Format::Pixel;
+
+    /*!
+     * View the whole image.
+     *
+     * @param image - Image to view, must outlive the view.
+     */
+    BasicImageView(BasicImage<Format> &image)
+        : width{image.width}, height{image.height}, stride{image.width}, data{image.getFramebuffer().data()} {}
+
+    /*!
+     * View an external buffer of pixels.
+     *
+     * @param data - First pixel of the first row.
+     * @param width - Width in pixels.
+     * @param height - Height in pixels.
+     * @param stride - Distance between the first pixels of two consecutive rows in pixels.
+     */
+    BasicImageView(Pixel *data, int width, int height, int stride)
+        : width{width}, height{height}, stride{stride}, data{data} {}
+
+    /*!
+     * View a rectangle inside of this view.
+     *
+     * @param x - Horizontal position of the top left corner.
+     * @param y - Vertical position of the top left corner.
+     * @param width - Width of the rectangle in pixels.
+     * @param height - Height of the rectangle in pixels.
+     * @return - View sharing the pixels of this view.
+     */
+    BasicImageView view(int x, int y, int width, int height) const {
+      if (x < 0 || y < 0 || width < 0 || height < 0 || x + width > this->width || y + height > this->height)
+        throw std::runtime_error{"Image view does not fit into the image"};
+      return {row(y) + x, width, height, stride};
+    }
+
+    /*!
+     * Get a row of pixels.
+     *
+     * @param y - Vertical position of the row.
+     * @return - Pointer to the first pixel of the row, the row contains width pixels.
+     */
+    Pixel *row(int y) const {
+      return data + (ptrdiff_t) y * stride;
+    }
+
+    /*!
+     * Get single pixel from the view.
+     *
+     * @param x - Horizontal position of the pixel in the view.
+     * @param y - Vertical position of the pixel in the view.
+     * @return - Reference to the pixel.
+     */
+    Pixel &getPixel(int x, int y) const {
+      return row(y)[x];
+    }
+
+    /*!
+     * Set pixel on coordinates x and y
+     * @param x Horizontal coordinate
+     * @param y Vertical coordinate
+     * @param color Pixel color to set
+     */
+    void setPixel(int x, int y, const Pixel &color) const {
+      row(y)[x] = color;
+    }
+
+    /*!
+     * @return - True when the rows follow each other without gaps so the whole view is a single block of memory.
+     */
+    bool contiguous() const {
+      return stride == width;
+    }
+
+    int width, height, stride;
+  private:
+    Pixel *data;
+  };
+
+  // Images of all supported formats, Image is the 8bit RGB image used by textures and image files
+  using Image = BasicImage<format::RGB8>;
+  using ImageRGBA8 = BasicImage<format::RGBA8>;
+  using ImageR32F = BasicImage<format::R32F>;
+  using ImageRGB32F = BasicImage<format::RGB32F>;
+  using DepthImage = BasicImage<format::Depth32F>;
+
+  // Views of images of all supported formats
+  using ImageView = BasicImageView<format::RGB8>;
+  using ImageRGBA8View = BasicImageView<format::RGBA8>;
+  using ImageR32FView = BasicImageView<format::R32F>;
+  using ImageRGB32FView = BasicImageView<format::RGB32F>;
+  using DepthImageView = BasicImageView<format::Depth32F>;
+
+  /*!
+   * Convert an image to another format using the normalized colors of the formats.
+   *
+   * @param image - Image to convert.
+   * @return - New image of the same size in the target format.
+   */
+  template<typename To, typename From>
+  BasicImage<To> convert(BasicImage<From> &image) {
+    BasicImage<To> result{image.width, image.height};
+    auto &source = image.getFramebuffer();
+    auto &target = result.getFramebuffer();
+    for (size_t i = 0; i < source.size(); i++)
+      target[i] = To::fromColor(From::toColor(source[i]));
+    return result;
+  }
+}
@@ -1,7 +1,11 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include "image_bmp.h"
+#include "mapped_file.h"
 
 namespace ppgso {
   namespace image {
@@ -37,17 +41,20 @@ namespace ppgso {
       BITMAPFILEHEADER bmpFileHeader = {};
       BITMAPINFOHEADER bmpInfoHeader = {};
 
-      std::ifstream input_file(bmp, std::ios::binary);
+      // Decode straight from the mapped file, no stream buffers or row copies are needed
+      MappedFile input_file(bmp);
 
       // Check headers
-      if (!input_file.is_open()) {
+      if (!input_file.isOpen()) {
         std::stringstream msg;
         msg << "Could not open BMP file. " << bmp;
         throw std::runtime_error(msg.str());
       }
 
-      input_file.read((char *) &bmpFileHeader, sizeof(BITMAPFILEHEADER));
-      input_file.read((char *) &bmpInfoHeader, sizeof(BITMAPINFOHEADER));
+      if (input_file.size() >= sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)) {
+        std::memcpy(&bmpFileHeader, input_file.data(), sizeof(BITMAPFILEHEADER));
+        std::memcpy(&bmpInfoHeader, input_file.data() + sizeof(BITMAPFILEHEADER), sizeof(BITMAPINFOHEADER));
+      }
 
       if (bmpFileHeader.bfType != 19778) {
         std::stringstream msg;
@@ -71,52 +78,64 @@ namespace ppgso {
       int height = abs(bmpInfoHeader.biHeight);
       bool flipped = bmpInfoHeader.biHeight < 0;
 
-      if (width == 0 || height == 0) {
+      if (width <= 0 || height == 0) {
         std::stringstream msg;
         msg << "BMP file does not contain any data. " << bmp;
         throw std::runtime_error(msg.str());
       }
 
-      Image image{width, height};
-      auto &framebuffer = image.getFramebuffer();
-
-      // Load data
-      input_file.seekg(bmpFileHeader.bfOffBits, input_file.beg);
-
       // BMP uses padding for rows
-      unsigned int row_padded = (width * sizeof(Image::Pixel) + 3) & (~3);
+      size_t row_padded = (width * sizeof(Image::Pixel) + 3) & (~3);
+      if (bmpFileHeader.bfOffBits + row_padded * height > input_file.size()) {
+        std::stringstream msg;
+        msg << "BMP file is truncated. " << bmp;
+        throw std::runtime_error(msg.str());
+      }
+
+      Image image{width, height};
+      ImageView view{image};
+      auto data = input_file.data() + bmpFileHeader.bfOffBits;
 
       for (int j = 0; j < height; j++) {
-        auto row_data = std::vector<Image::Pixel>(row_padded);
-        input_file.read((char *) row_data.data(), row_padded);
+        // Rows are stored bottom-up unless the height is negative
+        auto input_row = data + j * row_padded;
+        auto output_row = view.row(flipped ? j : height - 1 - j);
+        // Swap BGR to RGB, vectorized on targets with byte shuffles such as SSSE3 or NEON
+        #pragma omp simd
         for (int i = 0; i < width; i++) {
-          auto pixel = row_data[i];
-          std::swap(pixel.r, pixel.b);
-          if (flipped) {
-            framebuffer[i + j * width] = pixel;
-          } else {
-            framebuffer[i + (height - 1 - j) * width] = pixel;
-          }
+          output_row[i].r = input_row[i * 3 + 2];
+          output_row[i].g = input_row[i * 3 + 1];
+          output_row[i].b = input_row[i * 3];
         }
       }
-      input_file.close();
 
       return image;
     }
 
-    void saveBMP(ppgso::Image &image, const std::string &bmp) {
-      auto width = image.width;
-      auto height = image.height;
-      auto &framebuffer = image.getFramebuffer();
+    // Size of the headers written before the pixel data
+    const uint64_t BMP_HEADERS_SIZE = 122;
+
+    /*!
+     * Size of a padded row of a 24bit image in bytes.
+     */
+    static uint64_t rowSize(int width) {
+      return ((uint64_t) width * sizeof(Image::Pixel) + 3) & ~(uint64_t) 3;
+    }
 
-      unsigned int row_padded = (width * sizeof(Image::Pixel) + 3) & (~3);
+    /*!
+     * Write BMP headers for a bottom-up 24bit image and move the stream to the pixel data.
+     * The image has to pass BMPStream::fits so the sizes do not overflow the 32bit header fields.
+     * @return Size of a padded row in bytes.
+     */
+    static unsigned int writeHeaders(std::ofstream &output_file, int width, int height) {
+      auto row_padded = (unsigned int) rowSize(width);
 
       BITMAPFILEHEADER bmpFileHeader = {};
       bmpFileHeader.bfType = 19778;
-      bmpFileHeader.bfSize = row_padded * height + 122;
+      bmpFileHeader.bfSize = (unsigned int) ((uint64_t) row_padded * height + BMP_HEADERS_SIZE);
       bmpFileHeader.bfReserved1 = 0;
       bmpFileHeader.bfReserved2 = 0;
-      bmpFileHeader.bfOffBits = 122;
+      bmpFileHeader.bfOffBits = (unsigned int) BMP_HEADERS_SIZE;
 
       BITMAPINFOHEADER bmpInfoHeader = {};
       bmpInfoHeader.biSize = 108;
@@ -125,37 +144,76 @@ namespace ppgso {
       bmpInfoHeader.biPlanes = 1;
       bmpInfoHeader.biBitCount = 24;
       bmpInfoHeader.biCompression = 0;
-      bmpInfoHeader.biSizeImage = row_padded * height;
+      bmpInfoHeader.biSizeImage = (unsigned int) ((uint64_t) row_padded * height);
       bmpInfoHeader.biXPelsPerMeter = 2835;
       bmpInfoHeader.biYPelsPerMeter = 2835;
       bmpInfoHeader.biClrUsed = 0;
       bmpInfoHeader.biClrImportant = 0;
 
-      std::ofstream output_file(bmp, std::ios::binary);
+      output_file.write((char *) &bmpFileHeader, sizeof(BITMAPFILEHEADER));
+      output_file.write((char *) &bmpInfoHeader, sizeof(BITMAPINFOHEADER));
+
+      output_file.seekp(bmpFileHeader.bfOffBits, output_file.beg);
+      return row_padded;
+    }
 
-      if (!output_file.is_open()) {
+    void saveBMP(const ppgso::ImageView &image, const std::string &bmp) {
+      // Convert and write in bands so the conversion of a band overlaps with writing the previous one
+      const int bandHeight = 128;
+      BMPStream stream{bmp, image.width, image.height};
+      for (int y = 0; y < image.height; y += bandHeight)
+        stream.write(image.view(0, y, image.width, std::min(bandHeight, image.height - y)), y);
+      stream.close();
+    }
+
+    bool BMPStream::fits(int width, int height) {
+      return width > 0 && height > 0 && rowSize(width) * (uint64_t) height + BMP_HEADERS_SIZE <= UINT32_MAX;
+    }
+
+    BMPStream::BMPStream(const std::string &bmp, int width, int height) : width{width}, height{height} {
+      if (!fits(width, height)) {
+        std::stringstream msg;
+        msg << "Image of " << width << "x" << height << " pixels does not fit into a BMP file. " << bmp;
+        throw std::runtime_error(msg.str());
+      }
+
+      file.open(bmp, std::ios::binary);
+
+      if (!file.is_open()) {
         std::stringstream msg;
         msg << "Could not open BMP file for writing. " << bmp;
         throw std::runtime_error(msg.str());
       }
 
-      output_file.write((char *) &bmpFileHeader, sizeof(BITMAPFILEHEADER));
-      output_file.write((char *) &bmpInfoHeader, sizeof(BITMAPINFOHEADER));
+      rowPadded = writeHeaders(file, width, height);
+      dataOffset = file.tellp();
 
-      // Prepare BRG output data by swapping RGB to BRG and mirroring along height
-      output_file.seekp(bmpFileHeader.bfOffBits, output_file.beg);
+      // Allocate the whole file so bands can be written in any order
+      file.seekp(dataOffset + (std::streamoff) rowPadded * height - 1, file.beg);
+      file.put(0);
+    }
 
-      for (int j = 0; j < height; j++) {
-        auto output_row = std::vector<Image::Pixel>(row_padded);
+    void BMPStream::write(const ppgso::ImageView &band, int y) {
+      if (band.width != width || y < 0 || y + band.height > height)
+        throw std::runtime_error("BMP band does not fit into the image.");
+
+      // BMP rows are stored bottom-up so the last row of the band comes first in the file
+      size_t size = (size_t) rowPadded * band.height;
+      auto output = buffer(size);
+      #pragma omp parallel for
+      for (int j = 0; j < band.height; j++) {
+        auto input_row = band.row(band.height - 1 - j);
+        auto output_row = output + (size_t) j * rowPadded;
+        // Swap RGB to BGR, vectorized on targets with byte shuffles such as SSSE3 or NEON
+        #pragma omp simd
         for (int i = 0; i < width; i++) {
-          auto pixel = framebuffer[i + (height - 1 - j) * width];
-          std::swap(pixel.r, pixel.b);
-          output_row[i] = pixel;
+          output_row[i * 3] = input_row[i].b;
+          output_row[i * 3 + 1] = input_row[i].g;
+          output_row[i * 3 + 2] = input_row[i].r;
         }
-        output_file.write((char *) output_row.data(), row_padded);
+        std::fill(output_row + width * 3, output_row + rowPadded, 0);
       }
-
-      output_file.close();
+      submit(dataOffset + (std::streamoff) rowPadded * (height - y - band.height), size);
     }
   }
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "image.h"
+#include "image_stream.h"
 
 namespace ppgso {
 namespace image {
@@ -12,10 +13,46 @@ namespace image {
 
 /*!
  * Save as BMP image.
- * @param image - Image to save.
+ * @param image - Image or a view of its part to save.
  * @param bmp - Name of the BMP file to save image to.
  */
-  void saveBMP(ppgso::Image &image, const std::string &bmp);
+  void saveBMP(const ppgso::ImageView &image, const std::string &bmp);
+
+/*!
+ * BMP file that is written in bands of rows so the whole image never needs to be in memory.
+ * The file is allocated when opened and the bands can be written in any order, rows of a band are converted in parallel
+ * and written on a background thread while the next band is rendered.
+ */
+  class BMPStream : public ImageStream {
+  public:
+    /*!
+     * Create the BMP file and write its headers, throws when the image does not fit into a BMP file.
+     * @param bmp - Name of the BMP file to save image to.
+     * @param width - Width of the whole image in pixels.
+     * @param height - Height of the whole image in pixels.
+     */
+    BMPStream(const std::string &bmp, int width, int height);
+
+    /*!
+     * Write a band of rows to the file, the band can be reused as soon as this returns.
+     * @param band - Image or view containing the rows, its width must match the width of the file.
+     * @param y - Vertical position of the first row of the band in the whole image.
+     */
+    void write(const ppgso::ImageView &band, int y);
+
+    /*!
+     * Check whether the 32bit headers of a BMP file can describe an image, larger images need another format such as RAW.
+     * @param width - Width of the image in pixels.
+     * @param height - Height of the image in pixels.
+     * @return True if the file including its headers is at most 4GB.
+     */
+    static bool fits(int width, int height);
+
+    const int width, height;
+  private:
+    std::streamoff dataOffset;
+    unsigned int rowPadded;
+  };
 
 }
 }
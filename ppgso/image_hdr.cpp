@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "image_hdr.h"
+
+namespace ppgso {
+  namespace image {
+
+    // 8x8 Bayer matrix, thresholds are spread evenly over the interval between two quantization levels
+    const int DITHER_SIZE = 8;
+    const int BAYER[DITHER_SIZE][DITHER_SIZE] = {
+        { 0, 32,  8, 40,  2, 34, 10, 42},
+        {48, 16, 56, 24, 50, 18, 58, 26},
+        {12, 44,  4, 36, 14, 46,  6, 38},
+        {60, 28, 52, 20, 62, 30, 54, 22},
+        { 3, 35, 11, 43,  1, 33,  9, 41},
+        {51, 19, 59, 27, 49, 17, 57, 25},
+        {15, 47,  7, 39, 13, 45,  5, 37},
+        {63, 31, 55, 23, 61, 29, 53, 21}
+    };
+
+    // Bit pattern of 1.0f
+    const int32_t ONE_BITS = 0x3f800000;
+
+    /*!
+     * Convert a single row, channels are processed as one flat array so the loop vectorizes regardless of the pixel layout.
+     * @param input - Float channels of the row.
+     * @param output - 8bit channels of the row.
+     * @param count - Number of channels in the row.
+     * @param exposure - Scale of the colors.
+     * @param knee - 0 to clamp the colors, 1 to apply the Reinhard operator.
+     * @param inverseGamma - Exponent of the gamma correction, only used when Gamma is set.
+     * @param pattern - Dither thresholds of 8 pixels, each repeated for all three channels.
+     */
+    template<bool Gamma>
+    void toneMapRow(const float *input, uint8_t *output, int count, float exposure, float knee, float inverseGamma,
+                    const float *pattern) {
+      // Runs as long as the dither pattern so thresholds are loaded directly instead of being gathered
+      const int run = DITHER_SIZE * 3;
+      for (int start = 0; start < count; start += run) {
+        int size = std::min(run, count - start);
+        auto in = input + start;
+        auto out = output + start;
+        #pragma omp simd
+        for (int i = 0; i < size; i++) {
+          float c = in[i] * exposure;
+          c = c / (1.0f + knee * c);
+          // Clamp the bit pattern, floats compare like integers when positive and float compares would keep the loop scalar
+          int32_t bits;
+          std::memcpy(&bits, &c, sizeof(bits));
+          bits = std::min(std::max(bits, 0), ONE_BITS);
+          std::memcpy(&c, &bits, sizeof(bits));
+          if (Gamma) c = std::pow(c, inverseGamma);
+          // Truncation of values in <0,1> with thresholds in <0,1) never exceeds 255
+          out[i] = (uint8_t) (c * 255.0f + pattern[i]);
+        }
+      }
+    }
+
+    void toneMap(const ppgso::ImageRGB32FView &hdr, const ppgso::ImageView &image, const ToneMapping &settings) {
+      if (hdr.width != image.width || hdr.height != image.height)
+        throw std::runtime_error{"Tone mapped images must have the same size"};
+
+      float knee = settings.tone == ToneOperator::Reinhard ? 1.0f : 0.0f;
+      float inverseGamma = 1.0f / settings.gamma;
+      bool gamma = settings.gamma != 1.0f;
+      int count = hdr.width * 3;
+
+      #pragma omp parallel for
+      for (int y = 0; y < hdr.height; y++) {
+        float pattern[DITHER_SIZE * 3] = {};
+        if (settings.dither)
+          for (int i = 0; i < DITHER_SIZE * 3; i++)
+            pattern[i] = ((float) BAYER[y % DITHER_SIZE][i / 3] + 0.5f) / (DITHER_SIZE * DITHER_SIZE);
+
+        auto in = &hdr.row(y)->x;
+        auto out = &image.row(y)->r;
+        if (gamma)
+          toneMapRow<true>(in, out, count, settings.exposure, knee, inverseGamma, pattern);
+        else
+          toneMapRow<false>(in, out, count, settings.exposure, knee, inverseGamma, pattern);
+      }
+    }
+
+  }
+}
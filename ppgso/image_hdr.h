@@ -0,0 +1,37 @@
+#pragma once
+#include "image.h"
+
+namespace ppgso {
+namespace image {
+/*!
+ * Operator compressing high dynamic range colors into the displayable <0,1> range.
+ * - Clamp cuts off all values above 1, this is what setPixel does with float colors.
+ * - Reinhard maps each channel using c / (1 + c) so bright highlights keep their detail.
+ */
+  enum class ToneOperator {
+    Clamp, Reinhard
+  };
+
+/*!
+ * Settings of the conversion from a float framebuffer to an 8bit image, the defaults match setPixel.
+ */
+  struct ToneMapping {
+    // Scale of the colors before the tone operator is applied
+    float exposure = 1.0f;
+    ToneOperator tone = ToneOperator::Clamp;
+    // Display gamma, 1 stores linear colors and 2.2 approximates sRGB
+    float gamma = 1.0f;
+    // Add an ordered dither pattern before quantization to break up banding of smooth gradients
+    bool dither = false;
+  };
+
+/*!
+ * Tone map, gamma correct and quantize a float framebuffer into an 8bit image in one parallel pass.
+ * @param hdr - Float image or view with the accumulated colors.
+ * @param image - Image or view to store the result to, its size must match the float image.
+ * @param settings - Tone mapping settings.
+ */
+  void toneMap(const ppgso::ImageRGB32FView &hdr, const ppgso::ImageView &image, const ToneMapping &settings = {});
+
+}
+}
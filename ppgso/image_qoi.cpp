@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "image_qoi.h"
+#include "mapped_file.h"
+
+namespace ppgso {
+  namespace image {
+
+    // Chunk tags, 2bit tags are stored in the top bits of the first byte
+    const uint8_t QOI_OP_INDEX = 0x00;
+    const uint8_t QOI_OP_DIFF = 0x40;
+    const uint8_t QOI_OP_LUMA = 0x80;
+    const uint8_t QOI_OP_RUN = 0xc0;
+    const uint8_t QOI_OP_RGB = 0xfe;
+    const uint8_t QOI_OP_RGBA = 0xff;
+    const uint8_t QOI_MASK = 0xc0;
+
+    const int QOI_HEADER_SIZE = 14;
+    const uint8_t QOI_PADDING[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    // Limit of the specification, keeps the size of the decoded image well below 2GB
+    const uint64_t QOI_PIXELS_MAX = 400000000;
+
+    /*!
+     * Color with alpha as tracked by the codec, images without alpha use 255.
+     */
+    struct Color {
+      uint8_t r, g, b, a;
+
+      bool operator==(const Color &other) const {
+        return r == other.r && g == other.g && b == other.b && a == other.a;
+      }
+    };
+
+    /*!
+     * Position of a color in the table of recently seen colors.
+     */
+    static inline int hash(const Color &c) {
+      return (c.r * 3 + c.g * 5 + c.b * 7 + c.a * 11) % 64;
+    }
+
+    static inline uint32_t read32(const uint8_t *bytes) {
+      return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 8 | bytes[3];
+    }
+
+    static inline void write32(uint8_t *bytes, uint32_t value) {
+      bytes[0] = (uint8_t) (value >> 24);
+      bytes[1] = (uint8_t) (value >> 16);
+      bytes[2] = (uint8_t) (value >> 8);
+      bytes[3] = (uint8_t) value;
+    }
+
+    Image loadQOI(const std::string &qoi) {
+      MappedFile input_file(qoi);
+
+      if (!input_file.isOpen()) {
+        std::stringstream msg;
+        msg << "Could not open QOI file. " << qoi;
+        throw std::runtime_error(msg.str());
+      }
+
+      auto bytes = input_file.data();
+      auto size = input_file.size();
+      if (size < QOI_HEADER_SIZE + sizeof(QOI_PADDING) || std::memcmp(bytes, "qoif", 4) != 0) {
+        std::stringstream msg;
+        msg << "QOI file does not contain supported QOI format. " << qoi;
+        throw std::runtime_error(msg.str());
+      }
+
+      uint32_t width = read32(bytes + 4), height = read32(bytes + 8);
+      uint8_t channels = bytes[12];
+      if (width == 0 || height == 0 || (uint64_t) width * height > QOI_PIXELS_MAX || (channels != 3 && channels != 4)) {
+        std::stringstream msg;
+        msg << "QOI file does not contain any data. " << qoi;
+        throw std::runtime_error(msg.str());
+      }
+
+      Image image{(int) width, (int) height};
+      auto pixels = image.getFramebuffer().data();
+      size_t count = (size_t) width * height;
+
+      // Chunks are at most 5 bytes long and the stream ends with 8 bytes of padding, so a chunk starting before the padding never reads past the file
+      size_t position = QOI_HEADER_SIZE, end = size - sizeof(QOI_PADDING);
+      Color index[64] = {};
+      Color pixel{0, 0, 0, 255};
+      size_t i = 0;
+      while (i < count && position < end) {
+        uint8_t b1 = bytes[position++];
+        if (b1 == QOI_OP_RGB) {
+          pixel.r = bytes[position];
+          pixel.g = bytes[position + 1];
+          pixel.b = bytes[position + 2];
+          position += 3;
+        } else if (b1 == QOI_OP_RGBA) {
+          pixel = {bytes[position], bytes[position + 1], bytes[position + 2], bytes[position + 3]};
+          position += 4;
+        } else if ((b1 & QOI_MASK) == QOI_OP_INDEX) {
+          pixel = index[b1];
+        } else if ((b1 & QOI_MASK) == QOI_OP_DIFF) {
+          pixel.r = (uint8_t) (pixel.r + ((b1 >> 4) & 0x03) - 2);
+          pixel.g = (uint8_t) (pixel.g + ((b1 >> 2) & 0x03) - 2);
+          pixel.b = (uint8_t) (pixel.b + (b1 & 0x03) - 2);
+        } else if ((b1 & QOI_MASK) == QOI_OP_LUMA) {
+          uint8_t b2 = bytes[position++];
+          int vg = (b1 & 0x3f) - 32;
+          pixel.r = (uint8_t) (pixel.r + vg - 8 + ((b2 >> 4) & 0x0f));
+          pixel.g = (uint8_t) (pixel.g + vg);
+          pixel.b = (uint8_t) (pixel.b + vg - 8 + (b2 & 0x0f));
+        } else {
+          // Repeats the previous pixel, which is already in the table of recent colors
+          size_t run = std::min((size_t) (b1 & 0x3f) + 1, count - i);
+          std::fill_n(pixels + i, run, Image::Pixel{pixel.r, pixel.g, pixel.b});
+          i += run;
+          continue;
+        }
+        index[hash(pixel)] = pixel;
+        pixels[i++] = {pixel.r, pixel.g, pixel.b};
+      }
+      // Truncated streams repeat the last pixel like the reference decoder
+      std::fill(pixels + i, pixels + count, Image::Pixel{pixel.r, pixel.g, pixel.b});
+
+      return image;
+    }
+
+    void saveQOI(const ppgso::ImageView &image, const std::string &qoi) {
+      std::ofstream output_file(qoi, std::ios::binary);
+
+      if (!output_file.is_open()) {
+        std::stringstream msg;
+        msg << "Could not open QOI file for writing. " << qoi;
+        throw std::runtime_error(msg.str());
+      }
+
+      // Worst case is a full color chunk for every pixel, the whole file is encoded in memory and written at once
+      size_t count = (size_t) image.width * image.height;
+      std::vector<uint8_t> bytes(QOI_HEADER_SIZE + count * 4 + sizeof(QOI_PADDING));
+      std::memcpy(bytes.data(), "qoif", 4);
+      write32(&bytes[4], (uint32_t) image.width);
+      write32(&bytes[8], (uint32_t) image.height);
+      bytes[12] = 3;
+      // sRGB color space
+      bytes[13] = 0;
+
+      size_t position = QOI_HEADER_SIZE;
+      Color index[64] = {};
+      Color previous{0, 0, 0, 255};
+      int run = 0;
+      for (int y = 0; y < image.height; y++) {
+        auto row = image.row(y);
+        for (int x = 0; x < image.width; x++) {
+          Color pixel{row[x].r, row[x].g, row[x].b, 255};
+          if (pixel == previous) {
+            // Runs are limited to 62 pixels so they do not collide with the full color tags
+            if (++run == 62) {
+              bytes[position++] = (uint8_t) (QOI_OP_RUN | (run - 1));
+              run = 0;
+            }
+            continue;
+          }
+
+          if (run > 0) {
+            bytes[position++] = (uint8_t) (QOI_OP_RUN | (run - 1));
+            run = 0;
+          }
+
+          int h = hash(pixel);
+          if (index[h] == pixel) {
+            bytes[position++] = (uint8_t) (QOI_OP_INDEX | h);
+          } else {
+            index[h] = pixel;
+            // Differences wrap around like the 8bit channels
+            auto vr = (int8_t) (pixel.r - previous.r);
+            auto vg = (int8_t) (pixel.g - previous.g);
+            auto vb = (int8_t) (pixel.b - previous.b);
+            int vgr = vr - vg, vgb = vb - vg;
+            if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+              bytes[position++] = (uint8_t) (QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+            } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+              bytes[position++] = (uint8_t) (QOI_OP_LUMA | (vg + 32));
+              bytes[position++] = (uint8_t) ((vgr + 8) << 4 | (vgb + 8));
+            } else {
+              bytes[position++] = QOI_OP_RGB;
+              bytes[position++] = pixel.r;
+              bytes[position++] = pixel.g;
+              bytes[position++] = pixel.b;
+            }
+          }
+          previous = pixel;
+        }
+      }
+      if (run > 0)
+        bytes[position++] = (uint8_t) (QOI_OP_RUN | (run - 1));
+
+      std::memcpy(&bytes[position], QOI_PADDING, sizeof(QOI_PADDING));
+      position += sizeof(QOI_PADDING);
+
+      output_file.write((char *) bytes.data(), (std::streamsize) position);
+      output_file.close();
+    }
+
+  }
+}
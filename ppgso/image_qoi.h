@@ -0,0 +1,22 @@
+#pragma once
+#include "image.h"
+
+namespace ppgso {
+namespace image {
+/*!
+ * Load QOI image from file, the "Quite OK Image" format is a fast lossless compression of RGB and RGBA images.
+ * Alpha of RGBA files is ignored.
+ *
+ * @param qoi - File path to a QOI image.
+ */
+  ppgso::Image loadQOI(const std::string &qoi);
+
+/*!
+ * Save as lossless compressed QOI image with 3 channels.
+ * @param image - Image or a view of its part to save.
+ * @param qoi - Name of the QOI file to save image to.
+ */
+  void saveQOI(const ppgso::ImageView &image, const std::string &qoi);
+
+}
+}
@@ -1,7 +1,8 @@
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
-#include "image.h"
+#include "image_raw.h"
 
 namespace ppgso {
   namespace image {
@@ -25,7 +26,7 @@ namespace ppgso {
       return image;
     }
 
-    void saveRAW(Image &image, const std::string &raw) {
+    void saveRAW(const ImageView &image, const std::string &raw) {
       std::ofstream image_stream(raw, std::ios::binary);
 
       if (!image_stream.is_open()) {
@@ -34,12 +35,42 @@ namespace ppgso {
         throw std::runtime_error(msg.str());
       }
 
-      auto &framebuffer = image.getFramebuffer();
-
-      // Save the data
-      image_stream.write((char *) framebuffer.data(), framebuffer.size() * sizeof(Image::Pixel));
+      // Save the data, views of whole images are a single continuous block
+      if (image.contiguous()) {
+        image_stream.write((char *) image.row(0), (std::streamsize) image.width * image.height * sizeof(Image::Pixel));
+      } else {
+        for (int y = 0; y < image.height; y++)
+          image_stream.write((char *) image.row(y), (std::streamsize) image.width * sizeof(Image::Pixel));
+      }
       image_stream.close();
     }
 
+    RAWStream::RAWStream(const std::string &raw, int width, int height) : width{width}, height{height} {
+      file.open(raw, std::ios::binary);
+
+      if (!file.is_open()) {
+        std::stringstream msg;
+        msg << "Could not open image " << raw;
+        throw std::runtime_error(msg.str());
+      }
+
+      // Allocate the whole file so bands can be written in any order
+      file.seekp((std::streamoff) width * height * sizeof(Image::Pixel) - 1, file.beg);
+      file.put(0);
+    }
+
+    void RAWStream::write(const ImageView &band, int y) {
+      if (band.width != width || y < 0 || y + band.height > height)
+        throw std::runtime_error("RAW band does not fit into the image.");
+
+      // Rows are stored top to bottom without padding so the band is a single continuous block in the file
+      size_t rowSize = width * sizeof(Image::Pixel);
+      auto output = buffer(rowSize * band.height);
+      #pragma omp parallel for
+      for (int j = 0; j < band.height; j++)
+        std::memcpy(output + j * rowSize, band.row(j), rowSize);
+      submit((std::streamoff) width * y * sizeof(Image::Pixel), rowSize * band.height);
+    }
+
   }
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "image.h"
+#include "image_stream.h"
 
 namespace ppgso {
   namespace image {
@@ -12,9 +13,33 @@ namespace ppgso {
 
 /*!
  * Save as RAW image.
- * @param image - Image to save.
+ * @param image - Image or a view of its part to save.
  * @param raw - Name of the RAW file to save image to.
  */
-  void saveRAW(ppgso::Image &image, const std::string &raw);
+  void saveRAW(const ppgso::ImageView &image, const std::string &raw);
+
+/*!
+ * RAW file that is written in bands of rows so the whole image never needs to be in memory.
+ * The file is allocated when opened and the bands can be written in any order, bands are written on a background thread.
+ */
+  class RAWStream : public ImageStream {
+  public:
+    /*!
+     * Create the RAW file.
+     * @param raw - Name of the RAW file to save image to.
+     * @param width - Width of the whole image in pixels.
+     * @param height - Height of the whole image in pixels.
+     */
+    RAWStream(const std::string &raw, int width, int height);
+
+    /*!
+     * Write a band of rows to the file, the band can be reused as soon as this returns.
+     * @param band - Image or view containing the rows, its width must match the width of the file.
+     * @param y - Vertical position of the first row of the band in the whole image.
+     */
+    void write(const ppgso::ImageView &band, int y);
+
+    const int width, height;
+  };
  }
 }
@@ -0,0 +1,40 @@
+#include <stdexcept>
+
+#include "image_stream.h"
+
+namespace ppgso {
+  namespace image {
+
+    void ImageStream::wait() {
+      // Rethrows errors of the background write
+      if (pending.valid()) pending.get();
+    }
+
+    uint8_t *ImageStream::buffer(size_t size) {
+      auto &band = buffers[current];
+      if (band.size() < size) band.resize(size);
+      return band.data();
+    }
+
+    void ImageStream::submit(std::streamoff offset, size_t size) {
+      wait();
+      auto data = buffers[current].data();
+      pending = std::async(std::launch::async, [this, offset, data, size] {
+        file.seekp(offset, file.beg);
+        file.write((char *) data, (std::streamsize) size);
+        if (!file) throw std::runtime_error("Could not write band of rows to the image file.");
+      });
+      current = 1 - current;
+    }
+
+    void ImageStream::close() {
+      wait();
+      file.close();
+    }
+
+    ImageStream::~ImageStream() {
+      if (pending.valid()) pending.wait();
+    }
+
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <vector>
+
+namespace ppgso {
+namespace image {
+
+/*!
+ * Base of image files written in bands of rows. Converted bands are written on a background thread
+ * so the caller can render or convert the next band while the previous one is being written.
+ */
+  class ImageStream {
+  public:
+    ImageStream() = default;
+    ImageStream(const ImageStream &) = delete;
+    ImageStream &operator=(const ImageStream &) = delete;
+
+    /*!
+     * Wait for the last band to be written and close the file, errors of background writes are thrown from here.
+     */
+    void close();
+
+    /*!
+     * Wait for the last band and close the file, errors are ignored, call close to see them.
+     */
+    virtual ~ImageStream();
+
+  protected:
+    std::ofstream file;
+
+    /*!
+     * Get the buffer for the next band, it is not used by the background write.
+     * @param size - Size of the band in bytes.
+     * @return Buffer of at least the requested size, reused by following bands.
+     */
+    uint8_t *buffer(size_t size);
+
+    /*!
+     * Write the buffer returned by the last call of buffer on the background thread.
+     * Waits for the previous band first so at most one band is being written at a time.
+     * @param offset - Position of the band in the file.
+     * @param size - Size of the band in bytes.
+     */
+    void submit(std::streamoff offset, size_t size);
+
+  private:
+    // Two buffers, one is converted while the other is being written
+    std::vector<uint8_t> buffers[2];
+    int current = 0;
+    std::future<void> pending;
+
+    void wait();
+  };
+
+}
+}
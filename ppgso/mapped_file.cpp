@@ -0,0 +1,68 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+ppgso::MappedFile::MappedFile(const std::string &path) {
+  file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    file = nullptr;
+    return;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize)) return;
+  open = true;
+  length = (size_t) fileSize.QuadPart;
+  if (length == 0) return;
+
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping) bytes = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!bytes) {
+    open = false;
+    length = 0;
+  }
+}
+
+ppgso::MappedFile::~MappedFile() {
+  if (bytes) UnmapViewOfFile(bytes);
+  if (mapping) CloseHandle(mapping);
+  if (file) CloseHandle(file);
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ppgso::MappedFile::MappedFile(const std::string &path) {
+  int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) return;
+
+  struct stat status = {};
+  if (fstat(file, &status) == 0) {
+    open = true;
+    length = (size_t) status.st_size;
+    if (length > 0) {
+      // The mapping stays valid after the descriptor is closed
+      void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+      if (address != MAP_FAILED) {
+        bytes = static_cast<const uint8_t *>(address);
+        // Files are decoded front to back
+        madvise(address, length, MADV_SEQUENTIAL);
+      } else {
+        open = false;
+        length = 0;
+      }
+    }
+  }
+  close(file);
+}
+
+ppgso::MappedFile::~MappedFile() {
+  if (bytes) munmap(const_cast<uint8_t *>(bytes), length);
+}
+
+#endif
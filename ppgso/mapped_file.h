@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ppgso {
+
+  /*!
+   * Read only memory mapping of a whole file, image loaders decode straight from the mapped pages without copying them into stream buffers.
+   */
+  class MappedFile {
+  public:
+    /*!
+     * Map a file into memory, check isOpen to see if it succeeded.
+     *
+     * @param path - Path to the file.
+     */
+    MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /*!
+     * Unmap the file.
+     */
+    ~MappedFile();
+
+    /*!
+     * @return - True when the file was opened, empty files are open but do not have any data.
+     */
+    bool isOpen() const {
+      return open;
+    }
+
+    /*!
+     * @return - First byte of the file.
+     */
+    const uint8_t *data() const {
+      return bytes;
+    }
+
+    /*!
+     * @return - Size of the file in bytes.
+     */
+    size_t size() const {
+      return length;
+    }
+
+  private:
+    bool open = false;
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+  };
+}
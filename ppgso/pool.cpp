@@ -0,0 +1,46 @@
+#include <algorithm>
+
+#include "pool.h"
+
+ppgso::FramebufferPool::~FramebufferPool() {
+  release();
+  AlignedAllocator<uint8_t> allocator;
+  for (int bucket = 0; bucket < BUCKETS; bucket++)
+    for (auto buffer : buffers[bucket])
+      allocator.deallocate(static_cast<uint8_t *>(buffer), MIN_SIZE << bucket);
+}
+
+void *ppgso::FramebufferPool::allocate(size_t size) {
+  int bucket = 0;
+  while ((MIN_SIZE << bucket) < size) bucket++;
+  size_t bucketSize = MIN_SIZE << bucket;
+
+  std::lock_guard<std::mutex> guard{lock};
+  void *buffer;
+  if (!buffers[bucket].empty()) {
+    buffer = buffers[bucket].back();
+    buffers[bucket].pop_back();
+    statistics.hits++;
+  } else {
+    buffer = AlignedAllocator<uint8_t>{}.allocate(bucketSize);
+    statistics.misses++;
+    statistics.allocatedBytes += bucketSize;
+  }
+  acquired.emplace_back(buffer, bucket);
+  statistics.bytes += bucketSize;
+  statistics.peakBytes = std::max(statistics.peakBytes, statistics.bytes);
+  return buffer;
+}
+
+void ppgso::FramebufferPool::release() {
+  std::lock_guard<std::mutex> guard{lock};
+  for (auto &buffer : acquired)
+    buffers[buffer.second].push_back(buffer.first);
+  acquired.clear();
+  statistics.bytes = 0;
+}
+
+ppgso::FramebufferPool::Statistics ppgso::FramebufferPool::getStatistics() {
+  std::lock_guard<std::mutex> guard{lock};
+  return statistics;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "image.h"
+
+namespace ppgso {
+
+  /*!
+   * Pool of pixel and depth buffers reused across frames.
+   * Buffers are acquired during a frame and all of them are returned at once by release at the end of the frame.
+   * Sizes are rounded up to powers of two so buffers of similar sizes share buckets, once every bucket holds enough buffers
+   * frames of the same shape are served without any heap allocation. Buffers start at a cache line boundary and are not cleared.
+   */
+  class FramebufferPool {
+  public:
+    /*!
+     * Usage counters of the pool.
+     */
+    struct Statistics {
+      // Acquired buffers served from the pool and buffers that had to be allocated
+      size_t hits, misses;
+      // Bytes acquired and not yet released, the largest amount ever acquired at once and the bytes allocated by the pool
+      size_t bytes, peakBytes, allocatedBytes;
+    };
+
+    FramebufferPool() = default;
+    FramebufferPool(const FramebufferPool &) = delete;
+    FramebufferPool &operator=(const FramebufferPool &) = delete;
+
+    /*!
+     * Free all buffers, buffers that were not released must no longer be used.
+     */
+    ~FramebufferPool();
+
+    /*!
+     * Acquire uninitialized storage for an array, safe to call from multiple threads.
+     *
+     * @tparam T - Type of the elements, must be trivially copyable.
+     * @param count - Number of elements.
+     * @return - Pointer to the first element, valid until release is called.
+     */
+    template<typename T>
+    T *acquire(size_t count) {
+      return static_cast<T *>(allocate(count * sizeof(T)));
+    }
+
+    /*!
+     * Acquire an uninitialized image, safe to call from multiple threads.
+     *
+     * @tparam Format - Pixel format, see the ppgso::format namespace.
+     * @param width - Width in pixels.
+     * @param height - Height in pixels.
+     * @return - View of the image, valid until release is called.
+     */
+    template<typename Format>
+    BasicImageView<Format> acquireImage(int width, int height) {
+      return {acquire<typename Format::Pixel>((size_t) (width * height)), width, height, width};
+    }
+
+    /*!
+     * Return all acquired buffers to the pool, usually called at the end of a frame.
+     */
+    void release();
+
+    /*!
+     * @return - Usage counters since the pool was created.
+     */
+    Statistics getStatistics();
+
+  private:
+    // Smallest bucket is a single cache line, each following bucket doubles the size
+    static const size_t MIN_SIZE = 64;
+    static const int BUCKETS = 48;
+
+    std::mutex lock;
+    std::vector<void *> buffers[BUCKETS];
+    // Acquired buffers with their buckets
+    std::vector<std::pair<void *, int>> acquired;
+    Statistics statistics{};
+
+    void *allocate(size_t size);
+  };
+}
@@ -8,7 +8,11 @@
 #include "shader.h"
 #include "image.h"
 #include "image_bmp.h"
+#include "image_hdr.h"
+#include "image_qoi.h"
 #include "image_raw.h"
+#include "pool.h"
+#include "sampler.h"
 #include "texture.h"
 #include "window.h"
 
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+
+#include "sampler.h"
+
+ppgso::Sampler::Sampler(Image &image, Wrap wrap, Filter filter, Layout layout) : wrap{wrap}, filter{filter}, layout{layout} {
+  // Full resolution level in linear layout, the vertical axis is inverted so v=0 is the bottom of the image
+  std::vector<glm::vec3> linear((size_t) (image.width * image.height));
+  for (int y = 0; y < image.height; y++) {
+    for (int x = 0; x < image.width; x++) {
+      auto &pixel = image.getPixel(x, image.height - 1 - y);
+      linear[x + y * image.width] = glm::vec3{pixel.r, pixel.g, pixel.b};
+    }
+  }
+
+  int width = image.width, height = image.height;
+  while (true) {
+    // Store the level in the requested layout, swizzled layouts are padded to whole tiles or powers of two
+    Level level{width, height, (width + TILE - 1) / TILE, 0, false, {}};
+    int bitsX = 0, bitsY = 0;
+    while ((1 << bitsX) < width) bitsX++;
+    while ((1 << bitsY) < height) bitsY++;
+    level.mortonBits = std::min(bitsX, bitsY);
+    level.mortonLongX = bitsX > bitsY;
+    size_t size = (size_t) (width * height);
+    if (layout == Layout::Tiled) size = (size_t) (level.tilesX * ((height + TILE - 1) / TILE) * TILE * TILE);
+    if (layout == Layout::Morton) size = (size_t) 1 << (bitsX + bitsY);
+    level.texels.resize(size);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        auto &color = linear[x + y * width];
+        // Round the box filtered colors, truncating would darken every level after the first one
+        level.texels[index(level, x, y)] = {(uint8_t) (color.r + 0.5f), (uint8_t) (color.g + 0.5f), (uint8_t) (color.b + 0.5f)};
+      }
+    }
+    levels.push_back(std::move(level));
+
+    if (width == 1 && height == 1) break;
+
+    // Downsample using a 2x2 box filter
+    int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+    std::vector<glm::vec3> next((size_t) (nextWidth * nextHeight));
+    for (int y = 0; y < nextHeight; y++) {
+      for (int x = 0; x < nextWidth; x++) {
+        int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        next[x + y * nextWidth] = (linear[x0 + y0 * width] + linear[x1 + y0 * width] +
+                                   linear[x0 + y1 * width] + linear[x1 + y1 * width]) * 0.25f;
+      }
+    }
+    linear = std::move(next);
+    width = nextWidth;
+    height = nextHeight;
+  }
+}
+
+ppgso::Sampler::Texels ppgso::Sampler::gather(int level, int x, int y) const {
+  auto &mip = levels[level];
+  int x0 = address(x, mip.width), x1 = address(x + 1, mip.width);
+  int y0 = address(y, mip.height), y1 = address(y + 1, mip.height);
+  const Image::Pixel *texels[4] = {&texel(mip, x0, y0), &texel(mip, x1, y0), &texel(mip, x0, y1), &texel(mip, x1, y1)};
+
+  Texels result;
+  for (int i = 0; i < 4; i++) {
+    result.r[i] = texels[i]->r;
+    result.g[i] = texels[i]->g;
+    result.b[i] = texels[i]->b;
+  }
+  return result;
+}
+
+glm::vec3 ppgso::Sampler::nearest(int level, const glm::vec2 &texCoord) const {
+  auto &mip = levels[level];
+  int x = address((int) std::floor(texCoord.x * (float) mip.width), mip.width);
+  int y = address((int) std::floor(texCoord.y * (float) mip.height), mip.height);
+  auto &pixel = texel(mip, x, y);
+  return glm::vec3{pixel.r, pixel.g, pixel.b} / 255.0f;
+}
+
+glm::vec3 ppgso::Sampler::bilinear(int level, const glm::vec2 &texCoord) const {
+  // Texel centers are at half integer coordinates
+  auto &mip = levels[level];
+  float fx = texCoord.x * (float) mip.width - 0.5f;
+  float fy = texCoord.y * (float) mip.height - 0.5f;
+  float x0 = std::floor(fx), y0 = std::floor(fy);
+  float tx = fx - x0, ty = fy - y0;
+
+  // Weight all four texels of the footprint at once
+  auto texels = gather(level, (int) x0, (int) y0);
+  const float weights[4] = {(1 - tx) * (1 - ty), tx * (1 - ty), (1 - tx) * ty, tx * ty};
+  float r = 0, g = 0, b = 0;
+  #pragma omp simd reduction(+:r, g, b)
+  for (int i = 0; i < 4; i++) {
+    r += texels.r[i] * weights[i];
+    g += texels.g[i] * weights[i];
+    b += texels.b[i] * weights[i];
+  }
+  return glm::vec3{r, g, b} / 255.0f;
+}
+
+glm::vec3 ppgso::Sampler::sample(const glm::vec2 &texCoord, float lod) const {
+  // Keep repeated texture coordinates small to avoid precision issues
+  glm::vec2 uv = wrap == Wrap::Repeat ? texCoord - glm::floor(texCoord) : glm::clamp(texCoord, 0.0f, 1.0f);
+
+  lod = glm::clamp(lod, 0.0f, (float) (levels.size() - 1));
+  if (filter == Filter::Nearest) return nearest((int) (lod + 0.5f), uv);
+  if (filter == Filter::Bilinear) return bilinear((int) (lod + 0.5f), uv);
+
+  // Blend between two nearest levels
+  auto level = (int) lod;
+  float t = lod - (float) level;
+  if (t == 0 || level + 1 >= (int) levels.size()) return bilinear(level, uv);
+  return glm::mix(bilinear(level, uv), bilinear(level + 1, uv), t);
+}
+
+float ppgso::Sampler::lod(const glm::vec2 &dx, const glm::vec2 &dy) const {
+  // Longer side of the footprint in texels of the full resolution level
+  glm::vec2 size{levels[0].width, levels[0].height};
+  float footprint = std::max(glm::length(dx * size), glm::length(dy * size));
+  return footprint > 1 ? std::log2(footprint) : 0;
+}
+
+ppgso::Image ppgso::Sampler::image(int level) const {
+  auto &mip = levels[level];
+  Image result{mip.width, mip.height};
+  for (int y = 0; y < mip.height; y++)
+    for (int x = 0; x < mip.width; x++)
+      result.setPixel(x, mip.height - 1 - y, texel(mip, x, y));
+  return result;
+}
+
+size_t ppgso::Sampler::memoryUsage() const {
+  size_t size = 0;
+  for (auto &level : levels) size += level.texels.size() * sizeof(Image::Pixel);
+  return size;
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "image.h"
+
+namespace ppgso {
+
+  /*!
+   * Addressing of texture coordinates outside of the <0,1> range.
+   */
+  enum class Wrap {
+    Repeat, Clamp
+  };
+
+  /*!
+   * Filtering of texture lookups, similar to the OpenGL minification filters.
+   * Nearest and Bilinear use the mip level nearest to the requested level of detail, Trilinear blends the two nearest levels.
+   */
+  enum class Filter {
+    Nearest, Bilinear, Trilinear
+  };
+
+  /*!
+   * Order of texels in memory. Row by row lookups along vertical or diagonal directions touch a new cache line for nearly every texel,
+   * swizzled layouts keep 2D neighbourhoods close in memory.
+   * - Linear stores rows of texels like the image framebuffer.
+   * - Tiled stores 4x4 tiles of texels, a tile fits into a single cache line so a bilinear lookup usually touches only one.
+   * - Morton orders texels along a Z-order curve, neighbourhoods of all sizes are close in memory.
+   */
+  enum class Layout {
+    Linear, Tiled, Morton
+  };
+
+  /*!
+   * CPU texture sampler with a mip pyramid used by the software renderers.
+   * Texture coordinates follow OpenGL, v=0 is the bottom row of the image as in object files generated by Blender 3D.
+   */
+  class Sampler {
+  public:
+    /*!
+     * Colors of a 2x2 texel footprint stored as a structure of arrays so all four texels are weighted at once.
+     * Texels are ordered by rows, x in the lowest bit of the index and y in the second bit.
+     */
+    struct Texels {
+      float r[4], g[4], b[4];
+    };
+
+    /*!
+     * Build the mip pyramid from an image using a 2x2 box filter.
+     *
+     * @param image - Image to use for the first level.
+     * @param wrap - Addressing of coordinates outside of the texture.
+     * @param filter - Filtering of the lookups.
+     * @param layout - Order of texels in memory.
+     */
+    Sampler(Image &image, Wrap wrap = Wrap::Repeat, Filter filter = Filter::Trilinear, Layout layout = Layout::Tiled);
+
+    /*!
+     * Filtered texture lookup.
+     *
+     * @param texCoord - Texture coordinates.
+     * @param lod - Level of detail, 0 is the full resolution level.
+     * @return - Color of the texture in range <0,1>.
+     */
+    glm::vec3 sample(const glm::vec2 &texCoord, float lod = 0) const;
+
+    /*!
+     * Level of detail of a pixel footprint, the derivatives are usually differences of texture coordinates of neighbouring pixels.
+     *
+     * @param dx - Screen space derivative of the texture coordinates in horizontal direction.
+     * @param dy - Screen space derivative of the texture coordinates in vertical direction.
+     * @return - Level of detail to sample with, 0 when the footprint is smaller than a texel.
+     */
+    float lod(const glm::vec2 &dx, const glm::vec2 &dy) const;
+
+    /*!
+     * Gather the 2x2 texels of a level with the top left texel at x, y, coordinates are wrapped or clamped.
+     *
+     * @param level - Mip level, 0 is the full resolution level.
+     * @param x - Horizontal texel position.
+     * @param y - Vertical texel position, 0 is the bottom row.
+     * @return - Texel colors in range <0,255>.
+     */
+    Texels gather(int level, int x, int y) const;
+
+    /*!
+     * Convert a level back to an image in linear layout.
+     *
+     * @param level - Mip level, 0 is the full resolution level.
+     * @return - Image with the texels of the level, the bottom row of the level is the last row of the image.
+     */
+    Image image(int level = 0) const;
+
+    /*!
+     * Position of a texel in the storage of its level, depends on the layout.
+     *
+     * @param level - Mip level, 0 is the full resolution level.
+     * @param x - Horizontal texel position inside of the level.
+     * @param y - Vertical texel position inside of the level.
+     * @return - Index of the texel in the level.
+     */
+    size_t index(int level, int x, int y) const {
+      return index(levels[level], x, y);
+    }
+
+    /*!
+     * @return - Width of the full resolution level in texels.
+     */
+    int width() const {
+      return levels[0].width;
+    }
+
+    /*!
+     * @return - Height of the full resolution level in texels.
+     */
+    int height() const {
+      return levels[0].height;
+    }
+
+    /*!
+     * @return - Number of mip levels.
+     */
+    int levelCount() const {
+      return (int) levels.size();
+    }
+
+    /*!
+     * @return - Memory used by all levels in bytes.
+     */
+    size_t memoryUsage() const;
+
+    Wrap wrap;
+    Filter filter;
+    const Layout layout;
+  private:
+    // Width and height of a tile in texels
+    static const int TILE = 4;
+
+    struct Level {
+      int width, height;
+      // Tiles in a row of the tiled layout
+      int tilesX;
+      // Number of bits of both coordinates interleaved in the Morton layout, remaining bits of the longer side are stored above them
+      int mortonBits;
+      bool mortonLongX;
+      std::vector<Image::Pixel> texels;
+    };
+    std::vector<Level> levels;
+
+    /*!
+     * Spread the lower 16 bits of a value so there is a zero bit between each of them.
+     */
+    static inline uint32_t spread(uint32_t value) {
+      value &= 0x0000FFFF;
+      value = (value | (value << 8)) & 0x00FF00FF;
+      value = (value | (value << 4)) & 0x0F0F0F0F;
+      value = (value | (value << 2)) & 0x33333333;
+      value = (value | (value << 1)) & 0x55555555;
+      return value;
+    }
+
+    /*!
+     * Position of a texel in the storage of a level, coordinates must already be inside of the level.
+     */
+    inline size_t index(const Level &level, int x, int y) const {
+      switch (layout) {
+        case Layout::Linear:
+          return (size_t) (x + y * level.width);
+        case Layout::Tiled:
+          return (size_t) (((y / TILE) * level.tilesX + x / TILE) * TILE * TILE + (y % TILE) * TILE + x % TILE);
+        default: {
+          // Low bits of both coordinates are interleaved, texels of a non-square level continue along the longer side
+          uint32_t mask = (1u << level.mortonBits) - 1;
+          uint32_t low = spread((uint32_t) x & mask) | spread((uint32_t) y & mask) << 1;
+          uint32_t high = (uint32_t) (level.mortonLongX ? x : y) >> level.mortonBits;
+          return (size_t) low | (size_t) high << (2 * level.mortonBits);
+        }
+      }
+    }
+
+    /*!
+     * Wrap or clamp a texel coordinate to the size of a level.
+     */
+    inline int address(int coordinate, int size) const {
+      // Most coordinates are already inside, the division is only needed when they are not
+      if ((unsigned) coordinate < (unsigned) size) return coordinate;
+      if (wrap == Wrap::Clamp) return coordinate < 0 ? 0 : (coordinate >= size ? size - 1 : coordinate);
+      coordinate %= size;
+      return coordinate < 0 ? coordinate + size : coordinate;
+    }
+
+    /*!
+     * Get a texel of a level, coordinates must already be inside of the level.
+     */
+    inline const Image::Pixel &texel(const Level &level, int x, int y) const {
+      return level.texels[index(level, x, y)];
+    }
+
+    /*!
+     * Nearest texel lookup in a single level.
+     */
+    glm::vec3 nearest(int level, const glm::vec2 &texCoord) const;
+
+    /*!
+     * Bilinear lookup in a single level.
+     */
+    glm::vec3 bilinear(int level, const glm::vec2 &texCoord) const;
+  };
+}
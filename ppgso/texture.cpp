@@ -43,6 +43,16 @@ void ppgso::Texture::update() {
   glGenerateMipmap(GL_TEXTURE_2D);
 }
 
+void ppgso::Texture::update(int x, int y, int width, int height) {
+  bind();
+  // Rows of the region are taken from the full image framebuffer
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, image.width);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, &image.getPixel(x, y));
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 void ppgso::Texture::bind(int id) const {
   glActiveTexture((GLenum) (GL_TEXTURE0 + id));
   glBindTexture(GL_TEXTURE_2D, texture);
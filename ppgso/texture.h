@@ -35,6 +35,16 @@ namespace ppgso {
      */
     void update();
 
+    /*!
+     * Update only a rectangular region of the OpenGL texture, mipmaps are not regenerated.
+     *
+     * @param x - Horizontal position of the region in pixels.
+     * @param y - Vertical position of the region in pixels.
+     * @param width - Width of the region in pixels.
+     * @param height - Height of the region in pixels.
+     */
+    void update(int x, int y, int width, int height);
+
     /*!
      * Get OpenGL texture identifier number.
      *
@@ -213,9 +213,9 @@ struct World {
 
   /*!
    * Render the world to the provided image
-   * @param image Image to render to
+   * @param image Float image to accumulate the colors to
    */
-  void render(ppgso::Image& image, unsigned int samples) const {
+  void render(ppgso::ImageRGB32F& image, unsigned int samples) const {
     // Render section of the framebuffer
     for(int y = 0; y < image.height; ++y) {
       for (int x = 0; x < image.width; ++x) {
@@ -225,7 +225,7 @@ struct World {
           color = color + trace(ray);
         }
         color = color / (double) samples;
-        image.setPixel(x, y, (float) color.r, (float) color.g, (float) color.b);
+        image.setPixel(x, y, glm::vec3{color});
       }
     }
   }
@@ -259,8 +259,10 @@ int main() {
       },
   };
 
-  // Render the scene
-  world.render(image, 4);
+  // Render the scene into a float image and convert it at once
+  ppgso::ImageRGB32F hdr{image.width, image.height};
+  world.render(hdr, 4);
+  ppgso::image::toneMap(hdr, image);
 
   // Save the result
   ppgso::image::saveBMP(image, "raw2_raycast.bmp");
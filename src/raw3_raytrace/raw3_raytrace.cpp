@@ -212,9 +212,9 @@ struct World {
 
   /*!
    * Render the world to the provided image
-   * @param image Image to render to
+   * @param image Float image to accumulate the colors to
    */
-  void render(ppgso::Image& image, unsigned int samples, unsigned int depth) const {
+  void render(ppgso::ImageRGB32F& image, unsigned int samples, unsigned int depth) const {
     // For each pixel generate rays
     #pragma omp parallel for
     for (int y = 0; y < image.height; ++y) {
@@ -228,7 +228,7 @@ struct World {
         }
         // Collect the data
         color = color / (double) samples;
-        image.setPixel(x, y, (float)color.r, (float)color.g, (float)color.b);
+        image.setPixel(x, y, glm::vec3{color});
       }
     }
   }
@@ -261,8 +261,10 @@ int main() {
       },
   };
 
-  // Render the scene
-  world.render(image, 32, 5);
+  // Render the scene into a float image and convert it at once
+  ppgso::ImageRGB32F hdr{image.width, image.height};
+  world.render(hdr, 32, 5);
+  ppgso::image::toneMap(hdr, image);
 
   // Save the result
   ppgso::image::saveBMP(image, "raw3_raytrace.bmp");
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+#include "vertex.h"
+
+// Coverage is computed for blocks of 4x4 pixels at once, covered pixels are then shaded in 2x2 quads
+const int FRAGMENT_BLOCK = 4;
+const int BLOCK_LANES = FRAGMENT_BLOCK * FRAGMENT_BLOCK;
+const int QUAD_LANES = 4;
+
+// Pixel offsets of lanes within a block, each quad has consecutive lanes with x in the lowest bit and y in the second bit
+const int LANE_X[BLOCK_LANES] = {0, 1, 0, 1, 2, 3, 2, 3, 0, 1, 0, 1, 2, 3, 2, 3};
+const int LANE_Y[BLOCK_LANES] = {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 3, 3, 2, 2, 3, 3};
+
+/*!
+ * Quad of 2x2 fragments with varying data stored as a structure of arrays so every value is computed for all lanes at once
+ * Lanes not covered by the triangle still receive interpolated values so derivatives can be computed in every quad
+ */
+template<typename Varyings>
+struct Fragments {
+  // Number of varying components, shaders find their varyings using the offset of the member in the varyings structure
+  static const int COMPONENTS = VaryingTraits<Varyings>::COMPONENTS;
+
+  // Lanes covered by the triangle that passed the depth test
+  uint32_t mask;
+
+  // Varying data interpolated from the triangle vertices
+  float depth[QUAD_LANES];
+  float varying[COMPONENTS][QUAD_LANES];
+
+  // Fragment shader output, red, green and blue color
+  float output[3][QUAD_LANES];
+
+  /*!
+   * Horizontal screen space derivative of a value, difference of the neighbouring lanes in the quad
+   * @param value Value for all lanes
+   * @param lane Lane to compute the derivative for
+   */
+  static float dFdx(const float *value, int lane) {
+    return value[lane | 1] - value[lane & ~1];
+  }
+
+  /*!
+   * Vertical screen space derivative of a value, difference of the neighbouring lanes in the quad
+   * @param value Value for all lanes
+   * @param lane Lane to compute the derivative for
+   */
+  static float dFdy(const float *value, int lane) {
+    return value[lane | 2] - value[lane & ~2];
+  }
+};
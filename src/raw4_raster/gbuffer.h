@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <glm/glm.hpp>
+
+/*!
+ * Surface attributes of a pixel stored by the geometry pass of deferred shading, together with depth a pixel takes 16 bytes
+ */
+struct Surface {
+  // Unit normal in octahedral encoding, two signed 16bit components
+  int16_t normal[2];
+  // Texture coordinates wrapped to the <0,1) range like repeating textures do, unsigned 16bit components
+  uint16_t texCoord[2];
+  // Material of the surface, NO_MATERIAL for pixels not covered by any geometry
+  uint16_t material;
+  uint16_t padding;
+};
+
+const uint16_t NO_MATERIAL = 0xFFFF;
+
+// Number of pixels lit at once by the lighting pass
+const int SURFACE_LANES = 8;
+
+/*!
+ * Decoded surfaces of a row of pixels stored as a structure of arrays, the lighting shader computes all lanes at once
+ */
+struct Surfaces {
+  // Lanes with a surface to light
+  uint32_t mask;
+
+  float normal[3][SURFACE_LANES];
+  float texCoord[2][SURFACE_LANES];
+  uint16_t material[SURFACE_LANES];
+
+  // Lighting shader output, red, green and blue color
+  float output[3][SURFACE_LANES];
+};
+
+/*!
+ * Pack a normal and texture coordinates into a surface
+ * @param normal Normal to encode, does not need to be normalized
+ * @param texCoord Texture coordinates
+ * @param material Material of the surface
+ * @return Packed surface
+ */
+inline Surface encodeSurface(const glm::vec3 &normal, const glm::vec2 &texCoord, uint16_t material) {
+  // Project the normal onto an octahedron and unfold its lower half over the upper one
+  glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+  glm::vec2 octahedral{n.x, n.y};
+  if (n.z < 0)
+    octahedral = (1.0f - glm::abs(glm::vec2{n.y, n.x})) * glm::vec2{n.x >= 0 ? 1.0f : -1.0f, n.y >= 0 ? 1.0f : -1.0f};
+  // Round to the nearest representable value, away from zero at halfway
+  octahedral = glm::clamp(octahedral, -1.0f, 1.0f) * 32767.0f;
+  octahedral += glm::vec2{octahedral.x >= 0 ? 0.5f : -0.5f, octahedral.y >= 0 ? 0.5f : -0.5f};
+  // Coordinates rounded up to 1 wrap around to 0 which repeating textures sample the same
+  glm::vec2 uv = glm::fract(texCoord) * 65536.0f + 0.5f;
+  return {{(int16_t) octahedral.x, (int16_t) octahedral.y}, {(uint16_t) (uint32_t) uv.x, (uint16_t) (uint32_t) uv.y}, material, 0};
+}
+
+/*!
+ * Unpack the normal and texture coordinates of a surface
+ * @param surface Surface to decode
+ * @param normal Output unit normal
+ * @param texCoord Output texture coordinates
+ */
+inline void decodeSurface(const Surface &surface, float (&normal)[3], float (&texCoord)[2]) {
+  float x = surface.normal[0] / 32767.0f, y = surface.normal[1] / 32767.0f;
+  float z = 1.0f - std::abs(x) - std::abs(y);
+  // Fold the lower half of the octahedron back
+  float t = std::max(-z, 0.0f);
+  x += x >= 0 ? -t : t;
+  y += y >= 0 ? -t : t;
+  float length = std::sqrt(x * x + y * y + z * z);
+  normal[0] = x / length;
+  normal[1] = y / length;
+  normal[2] = z / length;
+  texCoord[0] = surface.texCoord[0] / 65536.0f;
+  texCoord[1] = surface.texCoord[1] / 65536.0f;
+}
+
+/*!
+ * Unpack the surfaces of consecutive pixels into lanes, decoding is the same for all lanes so the loop can be vectorized
+ * @param surface First of SURFACE_LANES surfaces
+ * @param surfaces Output lanes, the mask is set to the lanes with a material
+ */
+inline void decodeSurfaces(const Surface *surface, Surfaces &surfaces) {
+  surfaces.mask = 0;
+  for (int lane = 0; lane < SURFACE_LANES; lane++)
+    surfaces.mask |= (uint32_t) (surface[lane].material != NO_MATERIAL) << lane;
+
+  #pragma omp simd
+  for (int lane = 0; lane < SURFACE_LANES; lane++) {
+    float normal[3], texCoord[2];
+    decodeSurface(surface[lane], normal, texCoord);
+    surfaces.normal[0][lane] = normal[0];
+    surfaces.normal[1][lane] = normal[1];
+    surfaces.normal[2][lane] = normal[2];
+    surfaces.texCoord[0][lane] = texCoord[0];
+    surfaces.texCoord[1][lane] = texCoord[1];
+    surfaces.material[lane] = surface[lane].material;
+  }
+}
+
+/*!
+ * Programs support deferred shading when they provide a surface shader and a lighting shader for decoded surfaces:
+ * - Surface surfaceShader(const Varyings &) computing the surface of a fragment in the geometry pass
+ * - void lightingShader(Surfaces &) computing the colors of lanes of surfaces in the lighting pass
+ */
+template<typename Program, typename = void>
+struct SupportsDeferred : std::false_type {
+};
+
+template<typename Program>
+struct SupportsDeferred<Program, typename std::enable_if<std::is_same<Surface, decltype(std::declval<const Program &>().surfaceShader(
+    std::declval<const typename Program::Varyings &>()))>::value>::type> : std::true_type {
+};
@@ -0,0 +1,243 @@
+#pragma once
+#include <cstddef>
+#include <ppgso/ppgso.h>
+
+#include "vertex.h"
+#include "fragments.h"
+#include "gbuffer.h"
+
+// Shader programs are plain classes the rasterizer is specialized for at compile time, a program has to provide:
+// - Varyings structure of floats and float vectors that is interpolated over the triangle
+// - ShadedVertex<Varyings> vertexShader(const Vertex &) transforming a vertex into clip space
+// - glm::vec4 fragmentShader(const Varyings &) computing the color of a single fragment
+// - void fragmentShader(Fragments<Varyings> &) computing the colors of a 2x2 quad of fragments
+// Both fragment shaders are expected to compute the same colors, programs can also support deferred shading as described in gbuffer.h
+
+/*!
+ * Uniform transformations shared by the shader programs
+ */
+struct Transformation {
+  glm::mat4 modelMatrix;
+  glm::mat4 viewMatrix;
+  glm::mat4 projectionMatrix;
+
+  /*!
+   * Transform a position from model coordinates to clip space
+   */
+  glm::vec4 transform(const glm::vec4 &position) const {
+    // Transform the vertex position to world coordinates
+    glm::vec4 worldCoordinates = modelMatrix * position;
+    // Transform the position to camera coordinates
+    glm::vec4 cameraCoordinates = viewMatrix * worldCoordinates;
+    // Project the camera coordinates to screen coordinates
+    return projectionMatrix * cameraCoordinates;
+  }
+};
+
+/*!
+ * Program that colors fragments using a texture and vertex colors
+ */
+class TextureProgram : public Transformation {
+public:
+  /*!
+   * Program constructor that expects texture reference
+   */
+  TextureProgram(ppgso::Sampler &texture) : texture{texture} {};
+
+  // Uniform inputs common for all vertices
+  ppgso::Sampler &texture;
+
+  // Select the mip level of each fragment from the texture coordinate derivatives of its quad
+  // Only quad shading provides derivatives, single fragments always sample the full resolution level
+  bool mipmapping = false;
+
+  /*!
+   * Data interpolated for each fragment, normals are not used so they are not interpolated at all
+   */
+  struct Varyings {
+    glm::vec2 texCoord;
+    glm::vec4 color;
+  };
+
+  // Components of the varyings in quads of fragments
+  static const int TEX_COORD = offsetof(Varyings, texCoord) / sizeof(float);
+  static const int COLOR = offsetof(Varyings, color) / sizeof(float);
+
+  /*!
+   * Vertex shader is a program that can manipulate vertex data, typically changing the vertex position using a perspective projection matrix.
+   * @param vertex Vertex to manipulate.
+   * @return Output vertex, position on screen is expected to be in the <-1,1> range for x and y coordinates.
+   */
+  ShadedVertex<Varyings> vertexShader(const Vertex &vertex) const {
+    // Pass on color and texture coordinates unchanged.
+    return {transform(vertex.position), {vertex.texCoord, vertex.color}};
+  };
+
+  /*!
+   * Fragment shader is a program that is responsible for generating the final output color for each fragment, in this case we have 1 fragment per pixel.
+   * Shaders only read uniforms so they can be executed from multiple threads at once.
+   * @param varying Varying vertex data that is interpolated from the triangle vertices
+   * @return Fragment color
+   */
+  glm::vec4 fragmentShader(const Varyings &varying) const {
+    // Simple directional light
+    float lighting = 1;
+    // Compute output color
+    return varying.color * lighting * glm::vec4{texture.sample(varying.texCoord), 1.0f};
+  };
+
+  /*!
+   * Fragment shader for a whole quad of fragments, computes the same colors as the single fragment version
+   * Lanes are independent so the loop can be vectorized, texture lookups are gathered lane by lane
+   * @param fragments Varying data of the quad, output colors are written into it
+   */
+  void fragmentShader(Fragments<Varyings> &fragments) const {
+    auto texCoord = &fragments.varying[TEX_COORD], color = &fragments.varying[COLOR];
+
+    // Texture lookups are only needed for visible lanes
+    float sampled[3][QUAD_LANES] = {};
+    for (int lane = 0; lane < QUAD_LANES; lane++) {
+      if (!(fragments.mask >> lane & 1u)) continue;
+      float lod = 0;
+      if (mipmapping) {
+        using Quad = Fragments<Varyings>;
+        lod = texture.lod({Quad::dFdx(texCoord[0], lane), Quad::dFdx(texCoord[1], lane)},
+                          {Quad::dFdy(texCoord[0], lane), Quad::dFdy(texCoord[1], lane)});
+      }
+      auto texel = texture.sample({texCoord[0][lane], texCoord[1][lane]}, lod);
+      sampled[0][lane] = texel.r;
+      sampled[1][lane] = texel.g;
+      sampled[2][lane] = texel.b;
+    }
+
+    #pragma omp simd
+    for (int lane = 0; lane < QUAD_LANES; lane++) {
+      // Simple directional light
+      float lighting = 1;
+      // Compute output color
+      fragments.output[0][lane] = color[0][lane] * lighting * sampled[0][lane];
+      fragments.output[1][lane] = color[1][lane] * lighting * sampled[1][lane];
+      fragments.output[2][lane] = color[2][lane] * lighting * sampled[2][lane];
+    }
+  }
+};
+
+/*!
+ * Program that colors fragments by their normal in world coordinates, only the normal is interpolated
+ */
+class NormalProgram : public Transformation {
+public:
+  struct Varyings {
+    glm::vec3 normal;
+  };
+
+  static const int NORMAL = offsetof(Varyings, normal) / sizeof(float);
+
+  ShadedVertex<Varyings> vertexShader(const Vertex &vertex) const {
+    // Rotate normals into world coordinates
+    return {transform(vertex.position), {glm::mat3{modelMatrix} * glm::vec3{vertex.normal}}};
+  }
+
+  glm::vec4 fragmentShader(const Varyings &varying) const {
+    // Map the normal from the <-1,1> range to colors
+    return glm::vec4{varying.normal / glm::length(varying.normal) * 0.5f + 0.5f, 1.0f};
+  }
+
+  void fragmentShader(Fragments<Varyings> &fragments) const {
+    auto normal = &fragments.varying[NORMAL];
+    #pragma omp simd
+    for (int lane = 0; lane < QUAD_LANES; lane++) {
+      float length = std::sqrt(normal[0][lane] * normal[0][lane] + normal[1][lane] * normal[1][lane] + normal[2][lane] * normal[2][lane]);
+      for (int i = 0; i < 3; i++)
+        fragments.output[i][lane] = normal[i][lane] / length * 0.5f + 0.5f;
+    }
+  }
+};
+
+/*!
+ * Program that lights textured materials with a directional light and supports deferred shading
+ * Deferred shading packs texture coordinates wrapped to <0,1) so the textures need to repeat, forward shading uses the exact varyings
+ */
+class MaterialProgram : public Transformation {
+public:
+  /*!
+   * Program constructor that expects texture references for all materials
+   */
+  MaterialProgram(std::vector<ppgso::Sampler *> textures) : textures{std::move(textures)} {};
+
+  // Textures of the materials indexed by the material id
+  std::vector<ppgso::Sampler *> textures;
+  // Material of the rendered mesh
+  uint16_t material = 0;
+  // Direction towards the light in world coordinates and the amount of light reaching surfaces facing away from it
+  glm::vec3 lightDirection = normalize(glm::vec3{1, 1, 1});
+  float ambient = 0.3f;
+
+  struct Varyings {
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+  };
+
+  static const int NORMAL = offsetof(Varyings, normal) / sizeof(float);
+  static const int TEX_COORD = offsetof(Varyings, texCoord) / sizeof(float);
+
+  ShadedVertex<Varyings> vertexShader(const Vertex &vertex) const {
+    // Rotate normals into world coordinates
+    return {transform(vertex.position), {glm::mat3{modelMatrix} * glm::vec3{vertex.normal}, vertex.texCoord}};
+  }
+
+  /*!
+   * Surface shader of the geometry pass, only packs the varyings
+   */
+  Surface surfaceShader(const Varyings &varying) const {
+    return encodeSurface(varying.normal, varying.texCoord, material);
+  }
+
+  /*!
+   * Lighting shader of the deferred lighting pass
+   * @param surfaces Lanes of decoded surfaces, output colors are written into them
+   */
+  void lightingShader(Surfaces &surfaces) const {
+    // Diffuse lighting is computed for all lanes at once
+    float diffuse[SURFACE_LANES];
+    #pragma omp simd
+    for (int lane = 0; lane < SURFACE_LANES; lane++)
+      diffuse[lane] = lighting(surfaces.normal[0][lane], surfaces.normal[1][lane], surfaces.normal[2][lane]);
+
+    // Texture lookups are only needed for lanes with a surface
+    for (int lane = 0; lane < SURFACE_LANES; lane++) {
+      if (!(surfaces.mask >> lane & 1u)) continue;
+      auto texel = textures[surfaces.material[lane]]->sample({surfaces.texCoord[0][lane], surfaces.texCoord[1][lane]});
+      surfaces.output[0][lane] = texel.r * diffuse[lane];
+      surfaces.output[1][lane] = texel.g * diffuse[lane];
+      surfaces.output[2][lane] = texel.b * diffuse[lane];
+    }
+  }
+
+  glm::vec4 fragmentShader(const Varyings &varying) const {
+    glm::vec3 normal = glm::normalize(varying.normal);
+    float diffuse = lighting(normal.x, normal.y, normal.z);
+    auto texel = textures[material]->sample(varying.texCoord);
+    return {texel.r * diffuse, texel.g * diffuse, texel.b * diffuse, 1.0f};
+  }
+
+  void fragmentShader(Fragments<Varyings> &fragments) const {
+    auto normal = &fragments.varying[NORMAL], texCoord = &fragments.varying[TEX_COORD];
+    for (int lane = 0; lane < QUAD_LANES; lane++) {
+      if (!(fragments.mask >> lane & 1u)) continue;
+      auto color = fragmentShader({{normal[0][lane], normal[1][lane], normal[2][lane]}, {texCoord[0][lane], texCoord[1][lane]}});
+      fragments.output[0][lane] = color.r;
+      fragments.output[1][lane] = color.g;
+      fragments.output[2][lane] = color.b;
+    }
+  }
+
+private:
+  /*!
+   * Ambient and diffuse light reaching a surface with a unit normal
+   */
+  float lighting(float x, float y, float z) const {
+    float cosine = x * lightDirection.x + y * lightDirection.y + z * lightDirection.z;
+    return ambient + (1.0f - ambient) * std::max(cosine, 0.0f);
+  }
+};
@@ -0,0 +1,765 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "rasterizer.h"
+
+template<typename Program>
+Rasterizer<Program>::Rasterizer(ppgso::Image &image, Program &program, int samples) : program{program}, image{image},
+    depthBuffer{samples == 1 ? image.width : 0, samples == 1 ? image.height : 0}, samples{samples} {
+  if (samples != 1 && samples != MAX_SAMPLES)
+    throw std::runtime_error{"Unsupported number of samples per pixel"};
+  sampleReach = 0;
+  for (int sample = 0; sample < samples; sample++)
+    sampleReach = std::max({sampleReach, std::abs(SAMPLE_X[samples > 1][sample]), std::abs(SAMPLE_Y[samples > 1][sample])});
+
+  tilesX = (image.width + TILE_SIZE - 1) / TILE_SIZE;
+  tilesY = (image.height + TILE_SIZE - 1) / TILE_SIZE;
+  bins.resize((size_t) (tilesX * tilesY));
+
+  // View frustum planes in clip space
+  planes[LEFT_PLANE] = {1, 0, 0, 1};
+  planes[RIGHT_PLANE] = {-1, 0, 0, 1};
+  planes[BOTTOM_PLANE] = {0, 1, 0, 1};
+  planes[TOP_PLANE] = {0, -1, 0, 1};
+  planes[NEAR_PLANE] = {0, 0, 1, 1};
+  planes[FAR_PLANE] = {0, 0, -1, 1};
+
+  // Guard band planes keep viewport coordinates a pixel inside of the fixed point range
+  float guardX = 2.0f * (GUARD_BAND - 1.0f) / (float) image.width - 1.0f;
+  float guardY = 2.0f * (GUARD_BAND - 1.0f) / (float) image.height - 1.0f;
+  planes[GUARD_LEFT_PLANE] = {1, 0, 0, guardX};
+  planes[GUARD_RIGHT_PLANE] = {-1, 0, 0, guardX};
+  planes[GUARD_BOTTOM_PLANE] = {0, 1, 0, guardY};
+  planes[GUARD_TOP_PLANE] = {0, -1, 0, guardY};
+
+  clear();
+}
+
+template<typename Program>
+void Rasterizer<Program>::clear() {
+  // Clear the depth buffer in place, multisampled rendering uses only the sample buffers with every tile padded to the full tile size
+  if (samples == 1) {
+    depthBuffer.clear(std::numeric_limits<float>::max());
+  } else {
+    // Tiles are cleared when they are first rendered to, tiles without any geometry are never touched
+    size_t size = bins.size() * TILE_SIZE * TILE_SIZE * samples;
+    sampleColors.resize(size);
+    sampleDepths.resize(size);
+    clearedTiles.assign(bins.size(), 1);
+    writtenBlocks.assign(bins.size(), 0);
+  }
+  int blocksX = (image.width + BLOCK_SIZE - 1) / BLOCK_SIZE, blocksY = (image.height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  depthHierarchy.assign((size_t) (blocksX * blocksY), std::numeric_limits<float>::max());
+  // Clear the image
+  image.clear({128,128,128});
+  statistics = {};
+}
+
+template<typename Program>
+glm::vec4 Rasterizer<Program>::toViewport(const glm::vec4 &position) const {
+  // First convert homogeneous coordinates to cartesian
+  float invW = 1.0f / position.w;
+  glm::vec3 ndc = glm::vec3{position} * invW;
+  // Align the screen coordinates to viewport coordinates, y axis points down in the image
+  return {(ndc.x + 1.0f) * (float) image.width / 2.0f, (1.0f - ndc.y) * (float) image.height / 2.0f, ndc.z, invW};
+}
+
+template<typename Program>
+uint32_t Rasterizer<Program>::outcode(const glm::vec4 &position) const {
+  uint32_t code = 0;
+  for (int plane = 0; plane < PLANE_COUNT; plane++)
+    if (glm::dot(planes[plane], position) < 0)
+      code |= 1u << plane;
+  return code;
+}
+
+template<typename Program>
+FaceStatus Rasterizer<Program>::setup(const Shaded &v0, const Shaded &v1, const Shaded &v2, uint32_t c0, uint32_t c1, uint32_t c2, Triangle &triangle) const {
+  // Faces with all vertices outside of the same plane are never visible
+  if (c0 & c1 & c2) return FaceStatus::Outside;
+
+  // Faces crossing the near or far plane or the guard band have to be clipped, the rest is limited by the bounding box
+  if ((c0 | c1 | c2) & CLIP_PLANES) {
+    triangle.v0 = v0;
+    triangle.v1 = v1;
+    triangle.v2 = v2;
+    return FaceStatus::Clipped;
+  }
+
+  return setupTriangle(v0, v1, v2, triangle);
+}
+
+template<typename Program>
+FaceStatus Rasterizer<Program>::setupTriangle(const Shaded &v0, const Shaded &v1, const Shaded &v2, Triangle &triangle) const {
+  // Vertices may alias the triangle vertices, copy them before they are overwritten
+  Shaded vertices[3] = {v0, v1, v2};
+  triangle.v0 = vertices[0];
+  triangle.v1 = vertices[1];
+  triangle.v2 = vertices[2];
+
+  glm::vec4 p0 = toViewport(triangle.v0.position);
+  glm::vec4 p1 = toViewport(triangle.v1.position);
+  glm::vec4 p2 = toViewport(triangle.v2.position);
+
+  // Snap vertices to the sub-pixel grid
+  glm::i64vec2 f0{std::lround(p0.x * SUBPIXEL_ONE), std::lround(p0.y * SUBPIXEL_ONE)};
+  glm::i64vec2 f1{std::lround(p1.x * SUBPIXEL_ONE), std::lround(p1.y * SUBPIXEL_ONE)};
+  glm::i64vec2 f2{std::lround(p2.x * SUBPIXEL_ONE), std::lround(p2.y * SUBPIXEL_ONE)};
+
+  // Twice the signed area of the triangle, triangles that collapsed on the sub-pixel grid produce no fragments
+  int64_t area = Edge{f0, f1}.evaluate(f2.x, f2.y);
+  if (area == 0) return FaceStatus::Degenerate;
+
+  // Counter clockwise triangles in normalized device coordinates are clockwise on screen as the y axis is flipped
+  bool front = area < 0;
+  if ((cullMode == CullMode::Back && !front) || (cullMode == CullMode::Front && front))
+    return FaceStatus::Culled;
+
+  // Make the winding counter clockwise on screen
+  if (area < 0) {
+    std::swap(triangle.v1, triangle.v2);
+    std::swap(p1, p2);
+    std::swap(f1, f2);
+    area = -area;
+  }
+
+  // Bounding box of the pixels whose samples the triangle can cover, thin triangles may fall between pixel centers
+  int minX = (int) ((std::min({f0.x, f1.x, f2.x}) + SUBPIXEL_ONE / 2 - 1 - sampleReach) >> SUBPIXEL_BITS);
+  int minY = (int) ((std::min({f0.y, f1.y, f2.y}) + SUBPIXEL_ONE / 2 - 1 - sampleReach) >> SUBPIXEL_BITS);
+  int maxX = (int) ((std::max({f0.x, f1.x, f2.x}) - SUBPIXEL_ONE / 2 + sampleReach) >> SUBPIXEL_BITS);
+  int maxY = (int) ((std::max({f0.y, f1.y, f2.y}) - SUBPIXEL_ONE / 2 + sampleReach) >> SUBPIXEL_BITS);
+  if (minX > maxX || minY > maxY) return FaceStatus::Degenerate;
+
+  // Limit the bounding box to the image
+  triangle.minX = std::max(0, minX);
+  triangle.minY = std::max(0, minY);
+  triangle.maxX = std::min(image.width - 1, maxX);
+  triangle.maxY = std::min(image.height - 1, maxY);
+  if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return FaceStatus::Outside;
+
+  triangle.e0 = {f1, f2};
+  triangle.e1 = {f2, f0};
+  triangle.e2 = {f0, f1};
+
+  // Depth scaled by the area so it can be interpolated directly from the edge function values
+  triangle.depths = glm::vec3{p0.z, p1.z, p2.z} * (1.0f / (float) area);
+  triangle.inverseW = {p0.w, p1.w, p2.w};
+
+  // Nearest vertex depth lowered by the worst case rounding of interpolated depths
+  float farthest = std::max({std::abs(p0.z), std::abs(p1.z), std::abs(p2.z)});
+  triangle.minDepth = std::min({p0.z, p1.z, p2.z}) - DEPTH_EPSILON * farthest;
+  return FaceStatus::Visible;
+}
+
+template<typename Program>
+void Rasterizer<Program>::clip(const Triangle &face, std::vector<Triangle> &output) const {
+  // Sutherland-Hodgman clipping of the polygon against one plane after another, each plane adds at most one vertex
+  const int MAX_VERTICES = 3 + PLANE_COUNT;
+  Shaded polygon[MAX_VERTICES], clipped[MAX_VERTICES];
+  polygon[0] = face.v0;
+  polygon[1] = face.v1;
+  polygon[2] = face.v2;
+  int count = 3;
+
+  for (int plane = 0; plane < PLANE_COUNT && count >= 3; plane++) {
+    if (!(CLIP_PLANES >> plane & 1u)) continue;
+    int clippedCount = 0;
+    for (int i = 0; i < count; i++) {
+      auto &current = polygon[i], &next = polygon[(i + 1) % count];
+      float d0 = glm::dot(planes[plane], current.position);
+      float d1 = glm::dot(planes[plane], next.position);
+      if (d0 >= 0) clipped[clippedCount++] = current;
+      // Edges crossing the plane are split where the distance to the plane is zero
+      if ((d0 >= 0) != (d1 >= 0))
+        clipped[clippedCount++] = mix(current, next, d0 / (d0 - d1));
+    }
+    std::copy_n(clipped, clippedCount, polygon);
+    count = clippedCount;
+  }
+
+  // The clipped polygon is convex so it can be split into a fan of triangles
+  Triangle triangle;
+  for (int i = 1; i + 1 < count; i++)
+    if (setupTriangle(polygon[0], polygon[i], polygon[i + 1], triangle) == FaceStatus::Visible)
+      output.push_back(triangle);
+}
+
+template<typename Program>
+void Rasterizer<Program>::count(FaceStatus faceStatus) {
+  switch (faceStatus) {
+    case FaceStatus::Visible: statistics.visible++; break;
+    case FaceStatus::Clipped: statistics.clipped++; break;
+    case FaceStatus::Outside: statistics.outside++; break;
+    case FaceStatus::Culled: statistics.culled++; break;
+    case FaceStatus::Degenerate: statistics.degenerate++; break;
+  }
+}
+
+template<typename Program>
+bool Rasterizer<Program>::setFragment(int x, int y, float depth, const Triangle &triangle, const glm::vec3 &weights, const RenderTarget &target) const {
+  int index = (x - target.x) + (y - target.y) * target.width;
+
+  // Check and update the depth buffer before doing any interpolation
+  auto &storedDepth = target.depth[index];
+  if (storedDepth < depth)
+    return false;
+  storedDepth = depth;
+
+  if (target.surfaces)
+    shadeSurface(triangle, weights, target.surfaces[index], SupportsDeferred<Program>{});
+  else
+    target.color[index] = shade(triangle, weights);
+  return true;
+}
+
+template<typename Program>
+inline ppgso::Image::Pixel Rasterizer<Program>::shade(const Triangle &triangle, const glm::vec3 &weights) const {
+  // Compute the fragment color and limit the output
+  Varyings varying = interpolate(triangle.v0.varyings, triangle.v1.varyings, triangle.v2.varyings, weights);
+  glm::vec4 color = clamp(program.fragmentShader(varying), 0.0f, 1.0f);
+  return {(uint8_t) (color.r * 255), (uint8_t) (color.g * 255), (uint8_t) (color.b * 255)};
+}
+
+template<typename Program>
+template<typename>
+inline void Rasterizer<Program>::shadeSurface(const Triangle &triangle, const glm::vec3 &weights, Surface &surface, std::true_type) const {
+  surface = program.surfaceShader(interpolate(triangle.v0.varyings, triangle.v1.varyings, triangle.v2.varyings, weights));
+}
+
+template<typename Program>
+template<typename>
+void Rasterizer<Program>::light(const RenderTarget &target, std::true_type) const {
+  // Pixels of the tile are contiguous so they are lit in runs of lanes regardless of rows, the last run is padded
+  int count = target.width * target.height;
+  for (int first = 0; first < count; first += SURFACE_LANES) {
+    int lanes = std::min(SURFACE_LANES, count - first);
+    const Surface *surface = &target.surfaces[first];
+    Surface padded[SURFACE_LANES];
+    if (lanes < SURFACE_LANES) {
+      std::fill_n(padded, SURFACE_LANES, Surface{{0, 0}, {0, 0}, NO_MATERIAL, 0});
+      std::copy_n(surface, lanes, padded);
+      surface = padded;
+    }
+
+    Surfaces surfaces;
+    decodeSurfaces(surface, surfaces);
+    if (!surfaces.mask) continue;
+    program.lightingShader(surfaces);
+
+    // Limit the output the same way as forward shading
+    for (int lane = 0; lane < lanes; lane++) {
+      if (!(surfaces.mask >> lane & 1u)) continue;
+      auto &pixel = target.color[first + lane];
+      pixel.r = (uint8_t) (glm::clamp(surfaces.output[0][lane], 0.0f, 1.0f) * 255);
+      pixel.g = (uint8_t) (glm::clamp(surfaces.output[1][lane], 0.0f, 1.0f) * 255);
+      pixel.b = (uint8_t) (glm::clamp(surfaces.output[2][lane], 0.0f, 1.0f) * 255);
+    }
+  }
+}
+
+template<typename Program>
+void Rasterizer<Program>::updateMaxDepth(const RenderTarget &target, int bx, int by) const {
+  int endX = std::min(bx + BLOCK_SIZE, target.x + target.width);
+  int endY = std::min(by + BLOCK_SIZE, target.y + target.height);
+  float farthest = std::numeric_limits<float>::lowest();
+  for (int y = by; y < endY; y++) {
+    const float *row = &target.depth[(y - target.y) * target.width * samples];
+    #pragma omp simd reduction(max:farthest)
+    for (int i = (bx - target.x) * samples; i < (endX - target.x) * samples; i++)
+      farthest = std::max(farthest, row[i]);
+  }
+  target.maxDepth[(bx - target.x) / BLOCK_SIZE + (by - target.y) / BLOCK_SIZE * target.blocksX] = farthest;
+}
+
+template<typename Program>
+void Rasterizer<Program>::rasterize(const Triangle &triangle, const RenderTarget &target) const {
+  auto &e0 = triangle.e0, &e1 = triangle.e1, &e2 = triangle.e2;
+
+  // Bounding box limited to the target, aligned to blocks in image coordinates so every target sees the same blocks
+  int minX = std::max(triangle.minX, target.x);
+  int minY = std::max(triangle.minY, target.y);
+  int maxX = std::min(triangle.maxX, target.x + target.width - 1);
+  int maxY = std::min(triangle.maxY, target.y + target.height - 1);
+  minX -= minX % BLOCK_SIZE;
+  minY -= minY % BLOCK_SIZE;
+
+  // Largest depth of a block of pixels in the target
+  int blocksX = target.blocksX;
+  auto blockDepth = [&](int bx, int by) -> float & {
+    return target.maxDepth[(bx - target.x) / BLOCK_SIZE + (by - target.y) / BLOCK_SIZE * blocksX];
+  };
+
+  // Reject the whole triangle when it is behind everything already drawn in all blocks it overlaps
+  if (hierarchicalZ) {
+    float farthest = std::numeric_limits<float>::lowest();
+    for (int by = minY; by <= maxY; by += BLOCK_SIZE)
+      for (int bx = minX; bx <= maxX; bx += BLOCK_SIZE)
+        farthest = std::max(farthest, blockDepth(bx, by));
+    if (triangle.minDepth > farthest) return;
+  }
+
+  // Deferred shading only stores surfaces of single fragments
+  bool quads = quadShading && !target.surfaces;
+
+  // Edge function steps from the first lane of a fragment block to every other lane
+  LaneOffsets offsets;
+  if (quads)
+    for (int lane = 0; lane < BLOCK_LANES; lane++) {
+      offsets.edge[0][lane] = (double) ((e0.a * LANE_X[lane] + e0.b * LANE_Y[lane]) * SUBPIXEL_ONE);
+      offsets.edge[1][lane] = (double) ((e1.a * LANE_X[lane] + e1.b * LANE_Y[lane]) * SUBPIXEL_ONE);
+      offsets.edge[2][lane] = (double) ((e2.a * LANE_X[lane] + e2.b * LANE_Y[lane]) * SUBPIXEL_ONE);
+    }
+
+  // Edge function and depth steps from the pixel center to its samples
+  SampleOffsets sampleOffsets;
+  for (int sample = 0; sample < samples; sample++) {
+    int sx = SAMPLE_X[samples > 1][sample], sy = SAMPLE_Y[samples > 1][sample];
+    sampleOffsets.edge[0][sample] = e0.a * sx + e0.b * sy;
+    sampleOffsets.edge[1][sample] = e1.a * sx + e1.b * sy;
+    sampleOffsets.edge[2][sample] = e2.a * sx + e2.b * sy;
+    for (int e = 0; e < 3; e++)
+      sampleOffsets.farthest[e] = sample ? std::max(sampleOffsets.farthest[e], sampleOffsets.edge[e][sample]) : sampleOffsets.edge[e][sample];
+    sampleOffsets.depth[sample] = glm::dot(glm::vec3{(float) sampleOffsets.edge[0][sample], (float) sampleOffsets.edge[1][sample],
+                                                     (float) sampleOffsets.edge[2][sample]}, triangle.depths);
+  }
+
+  for (int by = minY; by <= maxY; by += BLOCK_SIZE) {
+    for (int bx = minX; bx <= maxX; bx += BLOCK_SIZE) {
+      // Reject blocks that are already covered by nearer geometry
+      if (hierarchicalZ && triangle.minDepth > blockDepth(bx, by)) continue;
+
+      // Outermost samples in the block corners
+      int64_t x0 = (int64_t) bx * SUBPIXEL_ONE + SUBPIXEL_ONE / 2 - sampleReach;
+      int64_t y0 = (int64_t) by * SUBPIXEL_ONE + SUBPIXEL_ONE / 2 - sampleReach;
+      int64_t x1 = x0 + (BLOCK_SIZE - 1) * SUBPIXEL_ONE + 2 * sampleReach;
+      int64_t y1 = y0 + (BLOCK_SIZE - 1) * SUBPIXEL_ONE + 2 * sampleReach;
+
+      // Edge functions are linear so the block is outside when all its corners are outside of one edge
+      bool outside = false, inside = true;
+      for (auto &e : {e0, e1, e2}) {
+        int corners = (e.evaluate(x0, y0) >= e.bias) + (e.evaluate(x1, y0) >= e.bias) +
+                      (e.evaluate(x0, y1) >= e.bias) + (e.evaluate(x1, y1) >= e.bias);
+        outside |= corners == 0;
+        inside &= corners == 4;
+      }
+      if (outside) continue;
+
+      bool written = false;
+      if (samples > 1) {
+        written = shadeSamples(triangle, sampleOffsets, bx, by, maxX, maxY, inside, target);
+        if (!written) continue;
+        *target.writtenBlocks |= 1ull << ((bx - target.x) / BLOCK_SIZE + (by - target.y) / BLOCK_SIZE * TILE_BLOCKS);
+        if (hierarchicalZ) updateMaxDepth(target, bx, by);
+        continue;
+      }
+      if (quads) {
+        for (int sy = by; sy <= std::min(by + BLOCK_SIZE - 1, maxY); sy += FRAGMENT_BLOCK)
+          for (int sx = bx; sx <= std::min(bx + BLOCK_SIZE - 1, maxX); sx += FRAGMENT_BLOCK)
+            written |= shadeBlock(triangle, offsets, sx, sy, maxX, maxY, target);
+        if (hierarchicalZ && written) updateMaxDepth(target, bx, by);
+        continue;
+      }
+
+      // Step the edge functions incrementally through the pixel centers of the block
+      int64_t row0 = e0.evaluate(x0, y0), row1 = e1.evaluate(x0, y0), row2 = e2.evaluate(x0, y0);
+      int endX = std::min(bx + BLOCK_SIZE, maxX + 1);
+      int endY = std::min(by + BLOCK_SIZE, maxY + 1);
+      for (int y = by; y < endY; ++y) {
+        int64_t w0 = row0, w1 = row1, w2 = row2;
+        for (int x = bx; x < endX; ++x) {
+          if (inside || (w0 >= e0.bias && w1 >= e1.bias && w2 >= e2.bias)) {
+            // Screen space barycentric coordinates interpolate depth linearly
+            glm::vec3 barycentric{(float) w0, (float) w1, (float) w2};
+            float depth = glm::dot(barycentric, triangle.depths);
+            // Attributes need perspective correction using 1/w, normalization cancels out the area
+            glm::vec3 weights = barycentric * triangle.inverseW;
+            weights *= 1.0f / (weights.x + weights.y + weights.z);
+            written |= setFragment(x, y, depth, triangle, weights, target);
+          }
+          w0 += e0.a * SUBPIXEL_ONE;
+          w1 += e1.a * SUBPIXEL_ONE;
+          w2 += e2.a * SUBPIXEL_ONE;
+        }
+        row0 += e0.b * SUBPIXEL_ONE;
+        row1 += e1.b * SUBPIXEL_ONE;
+        row2 += e2.b * SUBPIXEL_ONE;
+      }
+      if (hierarchicalZ && written) updateMaxDepth(target, bx, by);
+    }
+  }
+}
+
+template<typename Program>
+inline bool Rasterizer<Program>::shadeQuad(const Triangle &triangle, const std::array<const double *, 3> &edges, uint32_t covered, int qx, int qy, const RenderTarget &target) const {
+  // Screen space barycentric coordinates interpolate depth linearly
+  // Lanes outside of the triangle are clamped to it so their varyings stay finite
+  Fragments<Varyings> fragments;
+  float barycentric[3][QUAD_LANES];
+  #pragma omp simd
+  for (int lane = 0; lane < QUAD_LANES; lane++) {
+    barycentric[0][lane] = (float) std::max(edges[0][lane], 0.0);
+    barycentric[1][lane] = (float) std::max(edges[1][lane], 0.0);
+    barycentric[2][lane] = (float) std::max(edges[2][lane], 0.0);
+    fragments.depth[lane] = barycentric[0][lane] * triangle.depths.x + barycentric[1][lane] * triangle.depths.y
+                            + barycentric[2][lane] * triangle.depths.z;
+  }
+
+  // Check and update the depth buffer before doing any interpolation
+  int index[QUAD_LANES];
+  fragments.mask = 0;
+  for (int lane = 0; lane < QUAD_LANES; lane++) {
+    index[lane] = (qx + (lane & 1) - target.x) + (qy + (lane >> 1) - target.y) * target.width;
+    if (!(covered >> lane & 1u) || target.depth[index[lane]] < fragments.depth[lane]) continue;
+    target.depth[index[lane]] = fragments.depth[lane];
+    fragments.mask |= 1u << lane;
+  }
+  if (!fragments.mask) return false;
+
+  // Attributes need perspective correction using 1/w, normalization cancels out the area
+  float weights[3][QUAD_LANES];
+  #pragma omp simd
+  for (int lane = 0; lane < QUAD_LANES; lane++) {
+    float w0 = barycentric[0][lane] * triangle.inverseW.x;
+    float w1 = barycentric[1][lane] * triangle.inverseW.y;
+    float w2 = barycentric[2][lane] * triangle.inverseW.z;
+    float normalization = 1.0f / (w0 + w1 + w2);
+    weights[0][lane] = w0 * normalization;
+    weights[1][lane] = w1 * normalization;
+    weights[2][lane] = w2 * normalization;
+  }
+
+  // Interpolate all varyings, each component is one vectorized loop
+  auto interpolateLanes = [&](float *output, float a0, float a1, float a2) {
+    #pragma omp simd
+    for (int lane = 0; lane < QUAD_LANES; lane++)
+      output[lane] = a0 * weights[0][lane] + a1 * weights[1][lane] + a2 * weights[2][lane];
+  };
+  using Traits = VaryingTraits<Varyings>;
+  auto v0 = Traits::components(triangle.v0.varyings), v1 = Traits::components(triangle.v1.varyings),
+       v2 = Traits::components(triangle.v2.varyings);
+  for (int i = 0; i < Traits::COMPONENTS; i++)
+    interpolateLanes(fragments.varying[i], v0[i], v1[i], v2[i]);
+
+  program.fragmentShader(fragments);
+
+  // Limit the output, convert it to 8bit and write only the visible lanes
+  uint8_t output[3][QUAD_LANES];
+  for (int i = 0; i < 3; i++) {
+    #pragma omp simd
+    for (int lane = 0; lane < QUAD_LANES; lane++)
+      output[i][lane] = (uint8_t) (std::min(std::max(fragments.output[i][lane], 0.0f), 1.0f) * 255);
+  }
+  for (int lane = 0; lane < QUAD_LANES; lane++)
+    if (fragments.mask >> lane & 1u)
+      target.color[index[lane]] = {output[0][lane], output[1][lane], output[2][lane]};
+  return true;
+}
+
+template<typename Program>
+bool Rasterizer<Program>::shadeBlock(const Triangle &triangle, const LaneOffsets &offsets, int bx, int by, int maxX, int maxY, const RenderTarget &target) const {
+  auto &e0 = triangle.e0, &e1 = triangle.e1, &e2 = triangle.e2;
+
+  // Edge functions in the first pixel center of the block
+  int64_t x0 = (int64_t) bx * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+  int64_t y0 = (int64_t) by * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+  auto base0 = (double) e0.evaluate(x0, y0), base1 = (double) e1.evaluate(x0, y0), base2 = (double) e2.evaluate(x0, y0);
+  auto bias0 = (double) e0.bias, bias1 = (double) e1.bias, bias2 = (double) e2.bias;
+  int limitX = maxX - bx, limitY = maxY - by;
+
+  // Coverage of all lanes, lanes outside of the target are never covered
+  double w[3][BLOCK_LANES];
+  int inside[BLOCK_LANES];
+  #pragma omp simd
+  for (int lane = 0; lane < BLOCK_LANES; lane++) {
+    w[0][lane] = base0 + offsets.edge[0][lane];
+    w[1][lane] = base1 + offsets.edge[1][lane];
+    w[2][lane] = base2 + offsets.edge[2][lane];
+    inside[lane] = (w[0][lane] >= bias0) & (w[1][lane] >= bias1) & (w[2][lane] >= bias2)
+                   & (LANE_X[lane] <= limitX) & (LANE_Y[lane] <= limitY);
+  }
+  uint32_t covered = 0;
+  for (int lane = 0; lane < BLOCK_LANES; lane++)
+    covered |= (uint32_t) inside[lane] << lane;
+
+  // Shade only quads with at least one covered pixel
+  bool written = false;
+  for (int quad = 0; quad < BLOCK_LANES / QUAD_LANES; quad++) {
+    uint32_t mask = covered >> (quad * QUAD_LANES) & 0xFu;
+    if (!mask) continue;
+    int first = quad * QUAD_LANES;
+    written |= shadeQuad(triangle, {&w[0][first], &w[1][first], &w[2][first]}, mask, bx + LANE_X[first], by + LANE_Y[first], target);
+  }
+  return written;
+}
+
+template<typename Program>
+bool Rasterizer<Program>::shadeSamples(const Triangle &triangle, const SampleOffsets &offsets, int bx, int by, int maxX, int maxY,
+                                       bool inside, const RenderTarget &target) const {
+  auto &e0 = triangle.e0, &e1 = triangle.e1, &e2 = triangle.e2;
+
+  // Step the edge functions incrementally through the pixel centers of the block
+  int64_t x0 = (int64_t) bx * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+  int64_t y0 = (int64_t) by * SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+  int64_t row0 = e0.evaluate(x0, y0), row1 = e1.evaluate(x0, y0), row2 = e2.evaluate(x0, y0);
+  int endX = std::min(bx + BLOCK_SIZE, maxX + 1);
+  int endY = std::min(by + BLOCK_SIZE, maxY + 1);
+  int64_t stepX0 = e0.a * SUBPIXEL_ONE, stepX1 = e1.a * SUBPIXEL_ONE, stepX2 = e2.a * SUBPIXEL_ONE;
+  uint32_t allSamples = (1u << samples) - 1;
+  bool written = false;
+  for (int y = by; y < endY; ++y) {
+    int64_t w0 = row0, w1 = row1, w2 = row2;
+    for (int x = bx; x < endX; ++x, w0 += stepX0, w1 += stepX1, w2 += stepX2) {
+      // Coverage of the samples, pixels with all samples outside of one edge are skipped before testing single samples
+      uint32_t covered = allSamples;
+      if (!inside) {
+        if (w0 + offsets.farthest[0] < e0.bias || w1 + offsets.farthest[1] < e1.bias || w2 + offsets.farthest[2] < e2.bias)
+          continue;
+        covered = 0;
+        for (int sample = 0; sample < samples; sample++)
+          covered |= (uint32_t) (w0 + offsets.edge[0][sample] >= e0.bias && w1 + offsets.edge[1][sample] >= e1.bias &&
+                                 w2 + offsets.edge[2][sample] >= e2.bias) << sample;
+        if (!covered) continue;
+      }
+
+      // Depth test of each covered sample, depth is interpolated from the pixel center to the sample position
+      int index = ((x - target.x) + (y - target.y) * target.width) * samples;
+      float depth = glm::dot(glm::vec3{(float) w0, (float) w1, (float) w2}, triangle.depths);
+      uint32_t visible = 0;
+      for (int sample = 0; sample < samples; sample++) {
+        float sampleDepth = depth + offsets.depth[sample];
+        auto &storedDepth = target.depth[index + sample];
+        if (!(covered >> sample & 1u) || storedDepth < sampleDepth) continue;
+        storedDepth = sampleDepth;
+        visible |= 1u << sample;
+      }
+
+      if (visible) {
+        // Shade once in the pixel center, centers outside of the triangle are clamped to it so varyings are not extrapolated
+        glm::vec3 barycentric{(float) std::max(w0, (int64_t) 0), (float) std::max(w1, (int64_t) 0), (float) std::max(w2, (int64_t) 0)};
+        glm::vec3 weights = barycentric * triangle.inverseW;
+        weights *= 1.0f / (weights.x + weights.y + weights.z);
+        auto color = shade(triangle, weights);
+        for (int sample = 0; sample < samples; sample++)
+          if (visible >> sample & 1u) target.color[index + sample] = color;
+        written = true;
+      }
+    }
+    row0 += e0.b * SUBPIXEL_ONE;
+    row1 += e1.b * SUBPIXEL_ONE;
+    row2 += e2.b * SUBPIXEL_ONE;
+  }
+  return written;
+}
+
+template<typename Program>
+RenderTarget Rasterizer<Program>::sampleTarget(int tile) {
+  int imageBlocksX = (image.width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  RenderTarget target{nullptr, nullptr, nullptr, (tile % tilesX) * TILE_SIZE, (tile / tilesX) * TILE_SIZE, 0, 0, imageBlocksX,
+                      &writtenBlocks[tile], nullptr};
+  target.width = std::min(TILE_SIZE, image.width - target.x);
+  target.height = std::min(TILE_SIZE, image.height - target.y);
+
+  // Samples of a tile are stored by rows of the tile, the depth hierarchy is used in place as tiles are aligned to blocks
+  size_t offset = (size_t) tile * TILE_SIZE * TILE_SIZE * samples;
+  target.color = &sampleColors[offset];
+  target.depth = &sampleDepths[offset];
+  if (clearedTiles[tile]) {
+    std::fill_n(target.color, TILE_SIZE * TILE_SIZE * samples, ppgso::Image::Pixel{128, 128, 128});
+    std::fill_n(target.depth, TILE_SIZE * TILE_SIZE * samples, std::numeric_limits<float>::max());
+    clearedTiles[tile] = 0;
+  }
+  target.maxDepth = &depthHierarchy[target.x / BLOCK_SIZE + target.y / BLOCK_SIZE * imageBlocksX];
+  return target;
+}
+
+template<typename Program>
+void Rasterizer<Program>::resolve(const RenderTarget &target) {
+  auto &framebuffer = image.getFramebuffer();
+  for (int block = 0; block < TILE_BLOCKS * TILE_BLOCKS; block++) {
+    if (!(*target.writtenBlocks >> block & 1u)) continue;
+    int bx = target.x + block % TILE_BLOCKS * BLOCK_SIZE, by = target.y + block / TILE_BLOCKS * BLOCK_SIZE;
+    int endX = std::min(bx + BLOCK_SIZE, target.x + target.width), endY = std::min(by + BLOCK_SIZE, target.y + target.height);
+
+    // Box filter, the average of all samples of a pixel, only used for the maximal number of samples
+    for (int y = by; y < endY; y++) {
+      for (int x = bx; x < endX; x++) {
+        const ppgso::Image::Pixel *pixel = &target.color[((x - target.x) + (y - target.y) * target.width) * MAX_SAMPLES];
+        unsigned r = MAX_SAMPLES / 2, g = MAX_SAMPLES / 2, b = MAX_SAMPLES / 2;
+        for (int sample = 0; sample < MAX_SAMPLES; sample++) {
+          r += pixel[sample].r;
+          g += pixel[sample].g;
+          b += pixel[sample].b;
+        }
+        framebuffer[x + y * image.width] = {(uint8_t) (r / MAX_SAMPLES), (uint8_t) (g / MAX_SAMPLES), (uint8_t) (b / MAX_SAMPLES)};
+      }
+    }
+  }
+  *target.writtenBlocks = 0;
+}
+
+template<typename Program>
+void Rasterizer<Program>::render(const Face &face) {
+  RenderTarget target{image.getFramebuffer().data(), depthBuffer.getFramebuffer().data(), depthHierarchy.data(), 0, 0, image.width, image.height,
+                      (image.width + BLOCK_SIZE - 1) / BLOCK_SIZE, nullptr, nullptr};
+  auto draw = [&](const Triangle &triangle) {
+    if (samples == 1) {
+      rasterize(triangle, target);
+      return;
+    }
+    // Multisampled buffers are stored by tiles, the written pixels are resolved right away
+    for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++) {
+      for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++) {
+        auto tileTarget = sampleTarget(tx + ty * tilesX);
+        rasterize(triangle, tileTarget);
+        resolve(tileTarget);
+      }
+    }
+  };
+
+  // Transform vertices
+  Shaded v0 = program.vertexShader(face.v0), v1 = program.vertexShader(face.v1), v2 = program.vertexShader(face.v2);
+  statistics.vertices += 3;
+
+  Triangle triangle;
+  auto faceStatus = setup(v0, v1, v2, outcode(v0.position), outcode(v1.position), outcode(v2.position), triangle);
+  count(faceStatus);
+  if (faceStatus == FaceStatus::Visible) {
+    statistics.triangles++;
+    draw(triangle);
+  } else if (faceStatus == FaceStatus::Clipped) {
+    std::vector<Triangle> clipped;
+    clip(triangle, clipped);
+    statistics.triangles += clipped.size();
+    for (auto &part : clipped)
+      draw(part);
+  }
+}
+
+template<typename Program>
+void Rasterizer<Program>::renderTile(int tile, TileBuffers &buffers) {
+  auto &bin = bins[tile];
+  if (bin.empty()) return;
+
+  // Multisampled tiles are already contiguous so they are rendered in place and resolved at once
+  if (samples > 1) {
+    auto target = sampleTarget(tile);
+    for (auto index : bin)
+      rasterize(triangles[index], target);
+    resolve(target);
+    return;
+  }
+
+  RenderTarget target{buffers.color, buffers.depth, buffers.maxDepth,
+                      (tile % tilesX) * TILE_SIZE, (tile / tilesX) * TILE_SIZE, 0, 0, 0, nullptr, nullptr};
+  target.width = std::min(TILE_SIZE, image.width - target.x);
+  target.height = std::min(TILE_SIZE, image.height - target.y);
+  target.blocksX = (target.width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  // Tiles are aligned to blocks so the depth hierarchy of a tile is a sub-rectangle of the image hierarchy
+  int imageBlocksX = (image.width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  int blocksX = target.blocksX, blocksY = (target.height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  size_t blockOffset = (size_t) (target.x / BLOCK_SIZE + target.y / BLOCK_SIZE * imageBlocksX);
+
+  // Load the tile, the image may already contain results of previous render calls
+  auto &framebuffer = image.getFramebuffer();
+  auto &depths = depthBuffer.getFramebuffer();
+  for (int y = 0; y < target.height; y++) {
+    size_t offset = (size_t) (target.x + (target.y + y) * image.width);
+    std::copy_n(&framebuffer[offset], target.width, &target.color[y * target.width]);
+    std::copy_n(&depths[offset], target.width, &target.depth[y * target.width]);
+  }
+  for (int y = 0; y < blocksY; y++)
+    std::copy_n(&depthHierarchy[blockOffset + y * imageBlocksX], blocksX, &target.maxDepth[y * blocksX]);
+
+  // Deferred shading starts with no surfaces, pixels not covered by this render call keep their color
+  bool deferTile = deferred && SupportsDeferred<Program>::value;
+  if (deferTile) {
+    target.surfaces = buffers.surfaces;
+    std::fill_n(target.surfaces, target.width * target.height, Surface{{0, 0}, {0, 0}, NO_MATERIAL, 0});
+  }
+
+  // Triangles are stored in submission order so overlapping fragments resolve the same way as on a single thread
+  for (auto index : bin)
+    rasterize(triangles[index], target);
+  if (deferTile)
+    light(target, SupportsDeferred<Program>{});
+
+  // Store the tile back
+  for (int y = 0; y < target.height; y++) {
+    size_t offset = (size_t) (target.x + (target.y + y) * image.width);
+    std::copy_n(&target.color[y * target.width], target.width, &framebuffer[offset]);
+    std::copy_n(&target.depth[y * target.width], target.width, &depths[offset]);
+  }
+  for (int y = 0; y < blocksY; y++)
+    std::copy_n(&target.maxDepth[y * blocksX], blocksX, &depthHierarchy[blockOffset + y * imageBlocksX]);
+}
+
+template<typename Program>
+void Rasterizer<Program>::render(const Mesh &mesh) {
+  // Vertex processing, vertices shared by several faces are transformed only once
+  transformed.resize(mesh.vertices.size());
+  outcodes.resize(mesh.vertices.size());
+  #pragma omp parallel for if (multithreaded)
+  for (int i = 0; i < (int) mesh.vertices.size(); i++) {
+    transformed[i] = program.vertexShader(mesh.vertices[i]);
+    outcodes[i] = outcode(transformed[i].position);
+  }
+  statistics.vertices += mesh.vertices.size();
+
+  // Triangle setup is independent for each face
+  auto faces = (int) mesh.faceCount();
+  triangles.resize((size_t) faces);
+  status.resize((size_t) faces);
+  #pragma omp parallel for if (multithreaded)
+  for (int i = 0; i < faces; i++) {
+    auto i0 = mesh.indices[i * 3], i1 = mesh.indices[i * 3 + 1], i2 = mesh.indices[i * 3 + 2];
+    status[i] = setup(transformed[i0], transformed[i1], transformed[i2], outcodes[i0], outcodes[i1], outcodes[i2], triangles[i]);
+  }
+
+  // Draw order of the visible triangles, triangles of clipped faces are stored after all faces but drawn in place of their face
+  order.clear();
+  for (uint32_t i = 0; i < (uint32_t) faces; i++) {
+    count(status[i]);
+    if (status[i] == FaceStatus::Visible) {
+      order.push_back(i);
+    } else if (status[i] == FaceStatus::Clipped) {
+      auto first = (uint32_t) triangles.size();
+      clip(triangles[i], triangles);
+      for (auto part = first; part < (uint32_t) triangles.size(); part++)
+        order.push_back(part);
+    }
+  }
+  statistics.triangles += order.size();
+  if (frontToBack)
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return triangles[a].minDepth < triangles[b].minDepth;
+    });
+
+  // Bin triangles into all tiles their bounding box overlaps, keeping the draw order
+  for (auto &bin : bins)
+    bin.clear();
+  for (auto i : order) {
+    auto &triangle = triangles[i];
+    for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++)
+      for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++)
+        bins[tx + ty * tilesX].push_back(i);
+  }
+
+  // Tiles do not share any pixels so they can be rendered independently
+  #pragma omp parallel if (multithreaded)
+  {
+    TileBuffers buffers{pool.acquire<ppgso::Image::Pixel>(TILE_SIZE * TILE_SIZE), pool.acquire<float>(TILE_SIZE * TILE_SIZE),
+                        pool.acquire<float>((TILE_SIZE / BLOCK_SIZE) * (TILE_SIZE / BLOCK_SIZE)),
+                        deferred ? pool.acquire<Surface>(TILE_SIZE * TILE_SIZE) : nullptr};
+    #pragma omp for schedule(dynamic)
+    for (int tile = 0; tile < (int) bins.size(); tile++)
+      renderTile(tile, buffers);
+  }
+  pool.release();
+}
+
+// Rasterizers for all programs of the example, the shaders are inlined into each of them
+template class Rasterizer<TextureProgram>;
+template class Rasterizer<NormalProgram>;
+template class Rasterizer<MaterialProgram>;
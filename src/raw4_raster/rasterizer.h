@@ -0,0 +1,436 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include <ppgso/ppgso.h>
+
+#include "vertex.h"
+#include "program.h"
+#include "gbuffer.h"
+
+// Number of fractional bits used for sub-pixel precision of vertex positions
+const int SUBPIXEL_BITS = 8;
+const int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+
+// Vertices further than this many pixels outside of the image would overflow the fixed point math
+const float GUARD_BAND = 16384.0f;
+
+// Size of pixel blocks that are tested against the triangle as a whole
+const int BLOCK_SIZE = 8;
+
+// Size of screen tiles triangles are binned into, a color and depth tile fits into the L1/L2 cache
+const int TILE_SIZE = 64;
+const int TILE_BLOCKS = TILE_SIZE / BLOCK_SIZE;
+static_assert(TILE_BLOCKS * TILE_BLOCKS <= 64, "Written blocks of a tile have to fit into a 64bit mask");
+
+// Multisampling patterns, sample offsets from the pixel center in sub-pixel units for 1 and 4 samples per pixel
+// Four samples use a rotated grid so nearly horizontal and vertical edges get four distinct coverage levels
+const int MAX_SAMPLES = 4;
+const int SAMPLE_X[2][MAX_SAMPLES] = {{0}, {-SUBPIXEL_ONE / 8, SUBPIXEL_ONE * 3 / 8, -SUBPIXEL_ONE * 3 / 8, SUBPIXEL_ONE / 8}};
+const int SAMPLE_Y[2][MAX_SAMPLES] = {{0}, {-SUBPIXEL_ONE * 3 / 8, -SUBPIXEL_ONE / 8, SUBPIXEL_ONE / 8, SUBPIXEL_ONE * 3 / 8}};
+
+// Relative error of interpolated depth that is tolerated when comparing triangles with the depth hierarchy
+const float DEPTH_EPSILON = 1e-5f;
+
+// Clipping planes in homogeneous clip space, a point is inside when the dot product with the plane is not negative
+enum ClipPlane {
+  // View frustum planes used to reject faces that are completely outside
+  LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE, NEAR_PLANE, FAR_PLANE,
+  // Guard band planes, faces only need to be clipped when they reach beyond the range of the fixed point coordinates
+  GUARD_LEFT_PLANE, GUARD_RIGHT_PLANE, GUARD_BOTTOM_PLANE, GUARD_TOP_PLANE,
+  PLANE_COUNT
+};
+
+// Outcode bits of planes faces are clipped against, clipping only at the guard band keeps the number of clipped faces low
+const uint32_t CLIP_PLANES = 1u << NEAR_PLANE | 1u << FAR_PLANE | 1u << GUARD_LEFT_PLANE | 1u << GUARD_RIGHT_PLANE |
+                             1u << GUARD_BOTTOM_PLANE | 1u << GUARD_TOP_PLANE;
+
+// Faces can be culled based on their winding, counter clockwise faces in normalized device coordinates are front faces as in OpenGL
+enum class CullMode {
+  None, Back, Front
+};
+
+/*!
+ * Result of preparing a face for rasterization
+ */
+enum class FaceStatus : uint8_t {
+  // Face is rasterized as a single triangle
+  Visible,
+  // Face crosses the near, far or guard band planes and is rasterized as one or more clipped triangles
+  Clipped,
+  // Face is completely outside of the view frustum
+  Outside,
+  // Face is facing away from the camera according to the cull mode
+  Culled,
+  // Face has zero area or does not cover any pixel center
+  Degenerate
+};
+
+/*!
+ * Number of faces by their status, collected since the last clear
+ */
+struct Statistics {
+  // Vertex shader invocations
+  size_t vertices;
+  size_t visible, clipped, outside, culled, degenerate;
+  // Triangles that reached the rasterizer, including all triangles created by clipping
+  size_t triangles;
+};
+
+/*!
+ * Edge function E(x, y) = a*x + b*y + c of a triangle edge in fixed point coordinates
+ * Points inside of a counter clockwise (on screen) triangle have positive values for all three edges
+ */
+struct Edge {
+  int64_t a, b, c;
+  // Smallest value considered inside, implements the top-left fill rule so shared edges are drawn exactly once
+  int64_t bias;
+
+  Edge() = default;
+
+  /*!
+   * Set up edge function from vertex v0 to vertex v1
+   */
+  Edge(const glm::i64vec2 &v0, const glm::i64vec2 &v1) {
+    a = v0.y - v1.y;
+    b = v1.x - v0.x;
+    c = v0.x * v1.y - v0.y * v1.x;
+    // With y pointing down, left edges grow to the right and top edges grow downwards
+    bool topLeft = a > 0 || (a == 0 && b > 0);
+    bias = topLeft ? 0 : 1;
+  }
+
+  /*!
+   * Evaluate the edge function in a point
+   */
+  inline int64_t evaluate(int64_t x, int64_t y) const {
+    return a * x + b * y + c;
+  }
+};
+
+/*!
+ * Triangle after vertex processing and setup, ready to be rasterized
+ */
+template<typename Varyings>
+struct Triangle {
+  // Vertex shader outputs
+  ShadedVertex<Varyings> v0, v1, v2;
+  // Edge functions, each one is opposite to the vertex it weights
+  Edge e0, e1, e2;
+  // Vertex depths divided by twice the triangle area and 1/w of each vertex
+  glm::vec3 depths, inverseW;
+  // Bounding box in pixels limited to the image
+  int minX, minY, maxX, maxY;
+  // Lower bound of all depths generated by the triangle
+  float minDepth;
+};
+
+/*!
+ * Region of the image that is being rendered into, either the whole image or a single tile
+ */
+struct RenderTarget {
+  // Colors and depths of all samples, samples of a pixel are stored next to each other
+  ppgso::Image::Pixel *color;
+  float *depth;
+  // Largest depth in each block of BLOCK_SIZE x BLOCK_SIZE pixels, stored by rows of blocks
+  float *maxDepth;
+  // Position and size of the region in the image, buffers are stored by rows of width pixels
+  int x, y, width, height;
+  // Number of blocks in a row of the depth hierarchy, the hierarchy may be shared with the whole image
+  int blocksX;
+  // Blocks of a multisampled tile written since the tile was last resolved, one bit for each block, null for other targets
+  uint64_t *writtenBlocks;
+  // Surfaces of the visible fragments stored instead of colors when shading is deferred, null for other targets
+  Surface *surfaces;
+};
+
+/*!
+ * Storage for a single tile that is reused by a thread for all tiles it renders, taken from the framebuffer pool of the rasterizer
+ */
+struct TileBuffers {
+  ppgso::Image::Pixel *color;
+  float *depth;
+  float *maxDepth;
+  Surface *surfaces;
+};
+
+/*!
+ * Edge function offsets of all lanes of a fragment block relative to its first lane
+ * Fixed point edge values stay below 2^53 so doubles represent them exactly, unlike 64bit integers they can be vectorized
+ */
+struct LaneOffsets {
+  double edge[3][BLOCK_LANES];
+};
+
+/*!
+ * Edge function and depth offsets of the samples of a pixel relative to the pixel center
+ */
+struct SampleOffsets {
+  int64_t edge[3][MAX_SAMPLES];
+  // Largest edge function offset of all samples for each edge
+  int64_t farthest[3];
+  float depth[MAX_SAMPLES];
+};
+
+/*!
+ * Simple rasterizer class that can render triangles into an image
+ * The rasterizer is specialized for a shader program at compile time so the shaders are inlined into the pixel loops
+ * and only the varyings declared by the program are interpolated, see program.h for the requirements on the program
+ */
+template<typename Program>
+class Rasterizer {
+private:
+  using Varyings = typename Program::Varyings;
+  using Shaded = ShadedVertex<Varyings>;
+  using Triangle = ::Triangle<Varyings>;
+
+  Program &program;
+  ppgso::Image &image;
+  ppgso::DepthImage depthBuffer;
+
+  // Number of samples per pixel, multisampled colors and depths are stored tile by tile so each tile is a contiguous block
+  const int samples;
+  std::vector<ppgso::Image::Pixel> sampleColors;
+  std::vector<float> sampleDepths;
+  // Tiles of the sample buffers that still have to be cleared before they are rendered to, clearing the image clears them all at once
+  std::vector<uint8_t> clearedTiles;
+  std::vector<uint64_t> writtenBlocks;
+  // Largest distance of a sample from the pixel center in sub-pixel units
+  int sampleReach;
+  // Largest depth of each block of pixels in the depth buffer, used to reject hidden triangles and blocks early
+  std::vector<float> depthHierarchy;
+
+  // Clipping planes in clip space, guard band planes depend on the image size
+  glm::vec4 planes[PLANE_COUNT];
+
+  // Per frame storage reused between render calls, vertex shader outputs and their outcodes are indexed like the mesh vertices
+  std::vector<Shaded> transformed;
+  std::vector<uint32_t> outcodes;
+  // Triangles created by clipping are stored after the triangles of all faces
+  std::vector<Triangle> triangles;
+  std::vector<FaceStatus> status;
+  std::vector<uint32_t> order;
+  std::vector<std::vector<uint32_t>> bins;
+  int tilesX, tilesY;
+
+  /*!
+   * Transform a vertex position from clip coordinates to viewport/image coordinates
+   * @param position Position to transform. The visible range is <-1,1> for x and y coordinates after perspective division
+   * @return Position in pixels for x and y, depth in z and 1/w in w for perspective correct interpolation
+   */
+  glm::vec4 toViewport(const glm::vec4 &position) const;
+
+  /*!
+   * Compute the outcode of a vertex position
+   * @param position Position in clip space
+   * @return Bit mask of planes the position is outside of
+   */
+  uint32_t outcode(const glm::vec4 &position) const;
+
+  /*!
+   * Classify a face with transformed vertices by their outcodes and prepare it for rasterization
+   * @param v0 First vertex in clip space
+   * @param v1 Second vertex in clip space
+   * @param v2 Third vertex in clip space
+   * @param c0 Outcode of the first vertex
+   * @param c1 Outcode of the second vertex
+   * @param c2 Outcode of the third vertex
+   * @param triangle Output triangle, vertices are stored even for faces that need to be clipped
+   * @return Status of the face, only visible faces can be rasterized directly
+   */
+  FaceStatus setup(const Shaded &v0, const Shaded &v1, const Shaded &v2, uint32_t c0, uint32_t c1, uint32_t c2, Triangle &triangle) const;
+
+  /*!
+   * Prepare a triangle with transformed vertices for rasterization, vertices must be inside of the guard band
+   * @param v0 First vertex in clip space
+   * @param v1 Second vertex in clip space
+   * @param v2 Third vertex in clip space
+   * @param triangle Output triangle
+   * @return Status of the triangle
+   */
+  FaceStatus setupTriangle(const Shaded &v0, const Shaded &v1, const Shaded &v2, Triangle &triangle) const;
+
+  /*!
+   * Clip a face against the near, far and guard band planes in clip space and prepare the resulting triangles
+   * @param face Face with vertices transformed by the vertex shader
+   * @param output Vector to append the visible triangles to
+   */
+  void clip(const Triangle &face, std::vector<Triangle> &output) const;
+
+  /*!
+   * Count a face in the statistics
+   */
+  void count(FaceStatus faceStatus);
+
+  /*!
+   * Rasterize and shade a triangle into a render target, only pixels inside the target region are touched
+   * @param triangle Triangle to rasterize
+   * @param target Target region and its color and depth buffers
+   */
+  void rasterize(const Triangle &triangle, const RenderTarget &target) const;
+
+  /*!
+   * Set the pixel in the output using varying data interpolated from the triangle vertices
+   * @param x Fragment horizontal position in the image
+   * @param y Fragment vertical position in the image
+   * @param depth Fragment depth
+   * @param triangle Triangle the fragment belongs to
+   * @param weights Perspective correct barycentric coordinates of the fragment
+   * @param target Target to write the fragment to
+   * @return True if the fragment passed the depth test
+   */
+  bool setFragment(int x, int y, float depth, const Triangle &triangle, const glm::vec3 &weights, const RenderTarget &target) const;
+
+  /*!
+   * Run the fragment shader for varying data interpolated from the triangle vertices
+   * @param triangle Triangle the fragment belongs to
+   * @param weights Perspective correct barycentric coordinates of the fragment
+   * @return Fragment color converted to 8bit
+   */
+  ppgso::Image::Pixel shade(const Triangle &triangle, const glm::vec3 &weights) const;
+
+  /*!
+   * Run the surface shader for varying data interpolated from the triangle vertices, only for programs supporting deferred shading
+   * Member templates are only instantiated when called, so the explicit instantiations do not require the deferred shaders
+   * @param triangle Triangle the fragment belongs to
+   * @param weights Perspective correct barycentric coordinates of the fragment
+   * @param surface Output surface
+   */
+  template<typename = void>
+  void shadeSurface(const Triangle &triangle, const glm::vec3 &weights, Surface &surface, std::true_type) const;
+  void shadeSurface(const Triangle &, const glm::vec3 &, Surface &, std::false_type) const {}
+
+  /*!
+   * Deferred lighting pass, light the stored surfaces of a tile and write their colors
+   * @param target Target of the tile with its surfaces
+   */
+  template<typename = void>
+  void light(const RenderTarget &target, std::true_type) const;
+  void light(const RenderTarget &, std::false_type) const {}
+
+  /*!
+   * Compute coverage of a 4x4 block of fragments at once and shade all of its quads that are at least partially covered
+   * @param triangle Triangle to rasterize
+   * @param offsets Edge function offsets of the lanes for this triangle
+   * @param bx Horizontal position of the block in the image
+   * @param by Vertical position of the block in the image
+   * @param maxX Last column of the image to write to
+   * @param maxY Last row of the image to write to
+   * @param target Target to write the fragments to
+   * @return True if any fragment passed the depth test
+   */
+  bool shadeBlock(const Triangle &triangle, const LaneOffsets &offsets, int bx, int by, int maxX, int maxY, const RenderTarget &target) const;
+
+  /*!
+   * Depth test, interpolate and shade a 2x2 quad of fragments at once using masked writes
+   * @param triangle Triangle to rasterize
+   * @param edges Edge function values of the quad lanes for each of the three edges
+   * @param covered Mask of lanes covered by the triangle
+   * @param qx Horizontal position of the quad in the image
+   * @param qy Vertical position of the quad in the image
+   * @param target Target to write the fragments to
+   * @return True if any fragment passed the depth test
+   */
+  bool shadeQuad(const Triangle &triangle, const std::array<const double *, 3> &edges, uint32_t covered, int qx, int qy, const RenderTarget &target) const;
+
+  /*!
+   * Compute coverage of all samples of a block of pixels, depth test the samples and shade each pixel with a visible sample once
+   * @param triangle Triangle to rasterize
+   * @param offsets Edge function and depth offsets of the samples from the pixel center for this triangle
+   * @param bx Horizontal position of the block in the image
+   * @param by Vertical position of the block in the image
+   * @param maxX Last column of the image to write to
+   * @param maxY Last row of the image to write to
+   * @param inside True if the block is completely inside of the triangle
+   * @param target Target to write the samples to
+   * @return True if any sample passed the depth test
+   */
+  bool shadeSamples(const Triangle &triangle, const SampleOffsets &offsets, int bx, int by, int maxX, int maxY, bool inside,
+                    const RenderTarget &target) const;
+
+  /*!
+   * Target for a tile of the multisampled buffers, samples are rendered directly into the buffers without copying the tile
+   * The tile is cleared first if the buffers were cleared since it was last rendered to
+   * @param tile Index of the tile
+   * @return Target of the tile
+   */
+  RenderTarget sampleTarget(int tile);
+
+  /*!
+   * Average the samples of all blocks of a tile written since the last resolve into the image
+   * @param target Multisampled target of the tile
+   */
+  void resolve(const RenderTarget &target);
+
+  /*!
+   * Recompute the largest depth of a block after fragments were written into it
+   * @param target Target the block belongs to
+   * @param bx Horizontal position of the block in the image
+   * @param by Vertical position of the block in the image
+   */
+  void updateMaxDepth(const RenderTarget &target, int bx, int by) const;
+
+  /*!
+   * Render all triangles binned to a tile using cache resident color and depth buffers
+   * @param tile Index of the tile
+   * @param buffers Storage for a single tile
+   */
+  void renderTile(int tile, TileBuffers &buffers);
+
+public:
+  // Faces culled by their winding
+  CullMode cullMode = CullMode::Back;
+
+  // Number of faces by their status since the last clear
+  Statistics statistics;
+
+  // Tile buffers of all threads, returned at the end of each render call so following frames do not allocate them again
+  ppgso::FramebufferPool pool;
+
+  // Render tiles on all available threads, the output does not depend on this setting
+  bool multithreaded = true;
+
+  // Shade fragments in 2x2 quads instead of one by one, the output does not depend on this setting
+  // Quads provide screen space derivatives but are slower than single fragments for small triangles without wide SIMD
+  // Multisampled rendering always shades single pixels
+  bool quadShading = false;
+
+  // Reject triangles and blocks of pixels behind already rendered geometry before any interpolation and shading
+  bool hierarchicalZ = true;
+
+  // Render triangles sorted by their nearest depth so hidden fragments are rejected as early as possible
+  // Only fragments of overlapping triangles with exactly the same depth may resolve differently than in submission order
+  bool frontToBack = false;
+
+  // Rasterize tiles into a compact G-buffer of surfaces first and light each visible pixel once afterwards, the output does not depend on this setting
+  // Shading cost no longer grows with depth complexity, only programs supporting deferred shading and tiled single sample rendering use it
+  bool deferred = false;
+
+  /*!
+   * Initialize the rasterizer
+   * @param image Image to render to
+   * @param program Program to use for rendering
+   * @param samples Number of samples per pixel, 1 or 4 for multisample anti-aliasing
+   */
+  Rasterizer(ppgso::Image &image, Program &program, int samples = 1);
+
+  /*!
+   * Clear depth buffer, image and statistics
+   */
+  void clear();
+
+  /*!
+   * Render a single face directly into the image on the calling thread
+   * Multisampled pixels covered by the face are resolved into the image immediately
+   * @param face Face to render
+   */
+  void render(const Face &face);
+
+  /*!
+   * Render an indexed mesh by transforming each of its vertices once, binning the faces into screen tiles and rasterizing tiles in parallel
+   * Faces overlapping in a pixel are resolved in the order of the indices so the result is identical to rendering them one by one,
+   * unless front to back ordering is enabled, multisampled tiles are resolved into the image once all their faces are rendered
+   * @param mesh Mesh to render
+   */
+  void render(const Mesh &mesh);
+};
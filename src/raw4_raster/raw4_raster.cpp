@@ -1,308 +1,276 @@
 // Example raw4_raster
 // - This example implements a very simple software rasterizer that mimics parts of the OpenGL pipeline with vertex and fragment shaders
-// - Some of the pipeline steps such as culling, clipping were skipped for simplicity and readability
-// - Triangle rendering is realized using horizontal triangle splitting and filling is implemented using linear interpolation
+// - Faces are clipped in homogeneous clip space only at the near and far planes and at a guard band, the rest is limited by bounding boxes
+// - Back facing and zero area triangles are culled before setup so they never reach the rasterizer
+// - Meshes are rendered from vertex and index buffers, each vertex shared by several faces is transformed only once
+// - Multisample anti-aliasing tests coverage and depth of 4 samples per pixel but shades each pixel only once
+// - The rasterizer is a template specialized for each shader program, programs declare the varyings they need so nothing else is interpolated
+// - Triangles are rasterized using edge functions evaluated in fixed point sub-pixel coordinates over blocks of pixels
+// - Vertex data is interpolated using perspective correct barycentric coordinates
+// - Triangles are binned into screen tiles after vertex processing and the tiles are rendered in parallel
+// - Fragments can be shaded in 2x2 quads with coverage masks computed for 4x4 blocks so the work on all lanes can be vectorized
+// - A hierarchy of per block maximal depths rejects hidden triangles and blocks before any interpolation or shading
+// - Deferred shading rasterizes tiles into a compact G-buffer of packed normals, texture coordinates and materials and lights each visible pixel once
+// - Run with "realtime" argument to render the spinning model every frame into a window, the title shows the frame time
+// - Run with "benchmark" argument to compare texel layouts of the sampler on rotated texturing and single threaded, tiled, quad shaded,
+//   hierarchical depth, deferred and multisampled rendering with three programs, the outputs are verified to match
 
 #include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <sstream>
 #include <ppgso/ppgso.h>
 #include <glm/gtx/euler_angles.hpp>
 
+#include "rasterizer.h"
+#include "realtime.h"
+
 /*!
- * Vertex structure to hold per vertex data in
+ * Load Wavefront obj file data as an indexed mesh
+ * @return Mesh that can be rendered
  */
-struct Vertex {
-  glm::vec4 position;
-  glm::vec4 normal;
-  glm::vec2 texCoord;
-  glm::vec4 color;
+Mesh loadObjFile(const std::string filename) {
+  // Using tiny obj loader from ppgso lib
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string err = tinyobj::LoadObj(shapes, materials, filename.c_str());
+
+  // Will only convert 1st shape to a Mesh
+  auto &shape = shapes[0].mesh;
+
+  // Tiny obj loader already merged vertices with the same position, normal and texture coordinates
+  Mesh mesh;
+  mesh.vertices.resize(shape.positions.size() / 3);
+  for (int i = 0; i < (int) mesh.vertices.size(); ++i) {
+    mesh.vertices[i] = Vertex{
+        {shape.positions[3 * i], shape.positions[3 * i + 1], shape.positions[3 * i + 2], 1},
+        {shape.normals[3 * i], shape.normals[3 * i + 1], shape.normals[3 * i + 2], 1},
+        {shape.texcoords[2 * i], shape.texcoords[2 * i + 1]},
+        {1, 1, 1, 1}
+    };
+  }
+  mesh.indices.assign(shape.indices.begin(), shape.indices.end());
+  return mesh;
 };
 
 /*!
- * Vertex interpolation function that interpolates position, normal, texCoord and color vectors between two vertices
- * @param v0 First vertex
- * @param v1 Second vertex
- * @param t Interpolation amount, range <0,1>
- * @return Linear combination of v0 and v1
+ * Measure time of a function call in milliseconds
  */
-Vertex lerp(const Vertex &v0, const Vertex &v1, float t) {
-  auto z = glm::lerp(1.0f / v0.position.z, 1.0f / v1.position.z, t);
-  auto texCoord = glm::lerp(v0.texCoord / v0.position.z, v1.texCoord / v1.position.z, t) / z;
-  return Vertex{
-      glm::lerp(v0.position, v1.position, t),
-      glm::lerp(v0.normal, v1.normal, t),
-      texCoord,
-      glm::lerp(v0.color, v1.color, t)
-  };
+template<typename Function>
+double measure(Function &&function) {
+  auto start = std::chrono::high_resolution_clock::now();
+  function();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
 }
 
+// Largest difference of a color channel allowed between deferred and forward shading
+const int DEFERRED_TOLERANCE = 1;
+
 /*!
- * Face structure to hold three vertices that form a triangle/face
+ * Rendering configuration compared in the benchmark
  */
-struct Face {
-  Vertex v0, v1, v2;
-};
-
-class Program {
-public:
-  /*!
-   * Program constructor that expects texture reference
-   */
-  Program(ppgso::Image &texture) : texture{texture} {};
-
-  // Uniform inputs common for all vertices
-  ppgso::Image &texture;
-  glm::mat4 modelMatrix;
-  glm::mat4 viewMatrix;
-  glm::mat4 projectionMatrix;
-
-  /*!
-   * Vertex shader is a program that can manipulate vertex data, typically changing the vertex position using a perspective projection matrix.
-   * @param vertex Vertex to manipulate.
-   * @return Output vertex, position on screen is expected to be in the <-1,1> range for x and y coordinates.
-   */
-  Vertex vertexShader(const Vertex &vertex) {
-    // Transform the vertex position to world coordinates
-    glm::vec4 worldCoordinates = modelMatrix * vertex.position;
-    // Transform the position to camera coordinates
-    glm::vec4 cameraCoordinates = viewMatrix * worldCoordinates;
-    // Project the camera coordinates to screen coordinates
-    glm::vec4 screenCoordinates = projectionMatrix * cameraCoordinates;
-    // Multiply normal with modelMatrix so that normals are always in world coordinates.
-    // Pass on color and texture coordinates unchanged.
-    return Vertex{screenCoordinates, modelMatrix * vertex.normal, vertex.texCoord, vertex.color};
-  };
-
-  /*!
-   * Fragment shader is a program that is responsible for generating the final output color for each fragment, in this case we have 1 fragment per pixel.
-   * @param varying Varying vertex data that is interpolated from the triangle vertices
-   * @return Fragment color
-   */
-  glm::vec4 fragmentShader(const Vertex &varying) {
-    // Simple directional light
-    float lighting = 1; //std::max(0.0f, (float) dot(varying.normal, vec4{.5f, .5f, .5f, 0.0f}));
-    // Compute output color
-    return varying.color * lighting * sample(texture, varying.texCoord);
-  };
-private:
-  /*!
-   * Get a color sample from image for given normalized texture coordinates
-   * @param image Image to obtain raw color information from.
-   * @param textCoord Normalized 2D coordinates to get color sample from.
-   * @return
-   */
-  glm::vec4 sample(ppgso::Image &image, glm::vec2 textCoord) {
-    // Get the appropriate pixel for given texture coordinates.
-    textCoord = clamp(textCoord, 0.0f, 1.0f);
-    auto x = (int) (textCoord.x * (image.width - 1));
-    auto y = (int) (textCoord.y * (image.height - 1));
-    // NOTE: The coordinates are vertically inverted for compatibility with object files generated using Blender 3D.
-    auto pixel = image.getPixel(x, image.height-y);
-    // Return normalized color vector
-    return glm::vec4{pixel.r / 255.0f, pixel.g / 255.0f, pixel.b / 255.0f, 1.0};
-  }
+struct Mode {
+  std::string name;
+  bool tiled, multithreaded, quadShading, hierarchicalZ, frontToBack, deferred;
+  int samples;
 };
 
 /*!
- * Simple rasterizer class that can render triangles into an image
+ * Compare rendering faces one by one on a single thread with tiled, quad shaded, hierarchical depth and deferred rendering
+ * @param name Name of the program
+ * @param mesh Mesh to render
+ * @param program Program to use for rendering
+ * @param size Width and height of the rendered image
+ * @return True if all of the modes produced identical images, deferred shading only within a tolerance
  */
-class Rasterizer {
-private:
-  Program &program;
-  ppgso::Image &image;
-  std::vector<float> depthBuffer;
-
-  /*!
-   * Transform a vertex from screen coordinates to viewport/image coordinates
-   * @param vertex Vertex to transform to viewport. The visible range is <-1,1> for x and y coordinates
-   * @return Vertex that has position transformed to viewport/image coordinates
-   */
-  Vertex toViewport(const Vertex &vertex) {
-    // Matrix that aligns the screen coordinates to viewport coordinates
-    static const glm::mat4 viewportMatrix = glm::translate(glm::scale(glm::mat4{1.0f}, glm::vec3{image.width / 2.0, -image.height / 2.0, 1.0}), glm::vec3{1, -1, 0});
-    // First convert homogeneous coordinates to cartesian and transform to viewport
-    glm::vec4 viewportCoordinates = viewportMatrix * (vertex.position / vertex.position.w);
-    // Copy rest of the data without change
-    return Vertex{viewportCoordinates, vertex.normal, vertex.texCoord, vertex.color};
-  }
-
-  /*!
-   * Set the pixel in the output using the varying data stored in Vertex
-   * @param x Fragment horizontal position
-   * @param y Fragment vertical position
-   * @param varying Varying vertex data to pass to fragment shader which will generate the pixel color
-   */
-  void setFragment(const Vertex &varying) {
-    int x = (int) varying.position.x;
-    int y = (int) varying.position.y;
-    // Do not render pixels outside of the image
-    if (x < 0 || y < 0 || x >= image.width || y >= image.height)
-      return;
-
-    // Check and update the depth buffer
-    if (depthBuffer[x + y * image.width] < varying.position.z)
-      return;
+template<typename Program>
+bool benchmark(const std::string &name, const Mesh &mesh, Program &program, int size) {
+  const int frames = 20;
+  const std::vector<Mode> modes = {
+      {"single threaded, scalar", false, false, false, false, false, false, 1},
+      {"tiled on one thread, scalar", true, false, false, false, false, false, 1},
+      {"tiled on one thread, 2x2 quads", true, false, true, false, false, false, 1},
+      {"tiled on one thread, scalar, hier. Z", true, false, false, true, false, false, 1},
+      {"tiled on one thread, scalar, hier. Z, sorted", true, false, false, true, true, false, 1},
+      {"tiled on all threads, scalar, hier. Z", true, true, false, true, false, false, 1},
+      {"tiled on all threads, quads, hier. Z", true, true, true, true, false, false, 1},
+      {"tiled on one thread, deferred", true, false, false, false, false, true, 1},
+      {"tiled on all threads, hier. Z, deferred", true, true, false, true, false, true, 1},
+      {"single threaded, 4x MSAA", false, false, false, false, false, false, 4},
+      {"tiled on one thread, 4x MSAA, hier. Z", true, false, false, true, false, false, 4},
+      {"tiled on all threads, 4x MSAA, hier. Z", true, true, false, true, false, false, 4},
+  };
 
-    depthBuffer[x + y * image.height] = varying.position.z;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << size << "x" << size << ", " << name << std::endl;
 
-    // Compute the fragment color and limit the output
-    glm::vec4 color = clamp(program.fragmentShader(varying), 0.0f, 1.0f);
-    image.setPixel(x, y, color.r, color.g, color.b);
-  }
+  // Reference image for each number of samples
+  std::map<int, ppgso::Image> references;
+  bool identical = true;
+  for (auto &mode : modes) {
+    ppgso::Image image{size, size};
+    Rasterizer<Program> rasterizer{image, program, mode.samples};
+    rasterizer.multithreaded = mode.multithreaded;
+    rasterizer.quadShading = mode.quadShading;
+    rasterizer.hierarchicalZ = mode.hierarchicalZ;
+    rasterizer.frontToBack = mode.frontToBack;
+    rasterizer.deferred = mode.deferred;
 
-  /*!
-   * Fill the top portion of a triangle that has split horizontally by using interpolation between vertices
-   * @param v0 - Top vertex of the triangle
-   * @param v1 - First bottom vertex
-   * @param v2 - Second bottom vertex
-   */
-  void renderTopTriangle(const Vertex &v0, const Vertex &v1, const Vertex &v2) {
-    for (int y = 0; v0.position.y + y <= v2.position.y; ++y) {
-      float yt = v0.position.y >= v2.position.y ? 0 : y / (v2.position.y - v0.position.y);
-      Vertex a = lerp(v0, v1, yt);
-      Vertex b = lerp(v0, v2, yt);
-      if (a.position.x > b.position.x) std::swap(a, b);
-      for (int x = 0; a.position.x + x <= b.position.x; ++x) {
-        float xt = a.position.x >= b.position.x ? 0 : x / (b.position.x - a.position.x);
-        Vertex varying = lerp(a, b, xt);
-        setFragment(varying);
-      }
-    }
-  }
-
-  /*!
-   * Fill the bottom portion of a triangle that has split horizontally by using interpolation between vertices
-   * @param v0 - First top vertex of the triangle
-   * @param v1 - Second top vertex
-   * @param v2 - Bottom vertex
-   */
-  void renderBottomTriangle(const Vertex &v0, const Vertex &v1, const Vertex &v2) {
-    for (int y = 0; v0.position.y + y <= v2.position.y; ++y) {
-      float yt =  v0.position.y >= v2.position.y ? 0 : y / (v2.position.y - v0.position.y);
-      Vertex a = lerp(v0, v2, yt);
-      Vertex b = lerp(v1, v2, yt);
-      if (a.position.x > b.position.x) std::swap(a, b);
-      for (int x = 0; a.position.x + x <= b.position.x; ++x) {
-        float xt = a.position.x >= b.position.x ? 0 : x / (b.position.x - a.position.x);
-        Vertex varying = lerp(a, b, xt);
-        setFragment(varying);
-      }
+    double time = 0;
+    for (int frame = 0; frame < frames; frame++) {
+      time += measure([&] {
+        rasterizer.clear();
+        if (mode.tiled) {
+          rasterizer.render(mesh);
+        } else {
+          for (size_t face = 0; face < mesh.faceCount(); face++)
+            rasterizer.render(mesh.face(face));
+        }
+      });
     }
-  }
-
-public:
-  /*!
-   * Initialize the rasterizer
-   * @param image Image to render to
-   * @param program Program to use for rendering
-   */
-  Rasterizer(ppgso::Image &image, Program &program) : program{program}, image{image} {
-    clear();
-  };
-
-  /*!
-   * Clear depth buffer and image
-   */
-  void clear() {
-    // Clear the depth buffer
-    depthBuffer = std::vector<float>((unsigned long) (image.width * image.height), std::numeric_limits<float>::max());
-    // Clear the image
-    image.clear({128,128,128});
-  }
 
-  /*!
-   * Render a face into the image
-   * @param face Face to render
-   */
-  void render(const Face &face) {
-    // transform vertices
-    Vertex t0 = toViewport(program.vertexShader(face.v0));
-    Vertex t1 = toViewport(program.vertexShader(face.v1));
-    Vertex t2 = toViewport(program.vertexShader(face.v2));
-    // Sort the vertices
-    if (t0.position.y > t1.position.y) std::swap(t0, t1);
-    if (t0.position.y > t2.position.y) std::swap(t0, t2);
-    if (t1.position.y > t2.position.y) std::swap(t1, t2);
-    // Split the triangle into top/bottom sections
-    float t = t0.position.y >= t2.position.y ? 0 : (t1.position.y - t0.position.y) / (t2.position.y - t0.position.y);
-    Vertex tm = lerp(t0, t2, t);
+    // First mode with the same number of samples is the reference the mode is compared to
+    auto &reference = references.emplace(mode.samples, image).first->second;
+    // Deferred shading quantizes normals and texture coordinates into the G-buffer so colors may differ slightly
+    int tolerance = mode.deferred ? DEFERRED_TOLERANCE : 0;
+    auto &a = reference.getFramebuffer(), &b = image.getFramebuffer();
+    bool equal = std::equal(a.begin(), a.end(), b.begin(), [&](const ppgso::Image::Pixel &p, const ppgso::Image::Pixel &q) {
+      return std::abs(p.r - q.r) <= tolerance && std::abs(p.g - q.g) <= tolerance && std::abs(p.b - q.b) <= tolerance;
+    });
+    identical &= equal;
 
-    // Render
-    renderTopTriangle(t0, tm, t1);
-    renderBottomTriangle(t1, tm, t2);
+    std::cout << "  " << std::setw(46) << std::left << mode.name << std::right << std::setw(8) << time / frames << " ms"
+              << (equal ? "" : "  OUTPUT DIFFERS") << std::endl;
   }
-};
+  return identical;
+}
 
 /*!
- * Load Wavefront obj file data as vector of faces for simplicity
- * @return vector of Faces that can be rendered
+ * Compare texel layouts of the sampler on a textured plane rotated on screen, one texel per pixel
+ * Cache misses of the texels read by the bilinear lookups are counted in a simulated 32 KiB direct mapped cache with 64 byte lines
+ * @param texture Texture to sample, should be too large for the caches
+ * @param size Width and height of the sampled area in pixels
  */
-std::vector<Face> loadObjFile(const std::string filename) {
-  // Using tiny obj loader from ppgso lib
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string err = tinyobj::LoadObj(shapes, materials, filename.c_str());
+void benchmarkLayouts(ppgso::Image &texture, int size) {
+  const int frames = 5;
+  const int cacheLines = 32 * 1024 / 64;
+  const std::vector<std::pair<std::string, ppgso::Layout>> layouts = {
+      {"linear", ppgso::Layout::Linear}, {"4x4 tiles", ppgso::Layout::Tiled}, {"Morton order", ppgso::Layout::Morton}};
 
-  // Will only convert 1st shape to Faces
-  auto &mesh = shapes[0].mesh;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << size << "x" << size << ", texture layouts of " << texture.width << "x" << texture.height << " texels" << std::endl;
+  for (auto &layout : layouts) {
+    ppgso::Sampler sampler{texture, ppgso::Wrap::Repeat, ppgso::Filter::Bilinear, layout.second};
+    for (int angle : {0, 45, 90})
+      for (bool blocks : {false, true}) {
+        // Texture coordinate steps of a screen pixel in both directions
+        float radians = (ppgso::PI / 180.0f) * (float) angle;
+        glm::vec2 texel{1.0f / (float) texture.width, 1.0f / (float) texture.height};
+        glm::vec2 du = glm::vec2{std::cos(radians), std::sin(radians)} * texel;
+        glm::vec2 dv = glm::vec2{-std::sin(radians), std::cos(radians)} * texel;
 
-  // Collect data in vectors
-  std::vector<glm::vec4> positions;
-  for (int i = 0; i < (int) mesh.positions.size() / 3; ++i)
-    positions.emplace_back(mesh.positions[3 * i], mesh.positions[3 * i + 1], mesh.positions[3 * i + 2], 1);
+        // Pixels are visited row by row over the whole image like in the raytracers or in blocks like the rasterizer visits them
+        int block = blocks ? BLOCK_SIZE : size;
+        auto traverse = [&](auto &&lookup) {
+          for (int by = 0; by < size; by += block)
+            for (int bx = 0; bx < size; bx += block)
+              for (int y = by; y < by + block; y++)
+                for (int x = bx; x < bx + block; x++)
+                  lookup(du * ((float) x + 0.5f) + dv * ((float) y + 0.5f));
+        };
 
-  std::vector<glm::vec4> normals;
-  for (int i = 0; i < (int) mesh.normals.size() / 3; ++i)
-    normals.emplace_back(mesh.normals[3 * i], mesh.normals[3 * i + 1], mesh.normals[3 * i + 2], 1);
+        glm::vec3 sum{0};
+        double time = 0;
+        for (int frame = 0; frame < frames; frame++)
+          time += measure([&] {
+            traverse([&](const glm::vec2 &texCoord) { sum += sampler.sample(texCoord); });
+          });
 
-  std::vector<glm::vec2> texcoords;
-  for (int i = 0; i < (int) mesh.texcoords.size() / 2; ++i)
-    texcoords.emplace_back(mesh.texcoords[2 * i], mesh.texcoords[2 * i + 1]);
+        // Replay the texels of the bilinear footprints through the simulated cache
+        std::vector<int64_t> cache(cacheLines, -1);
+        size_t misses = 0;
+        traverse([&](const glm::vec2 &texCoord) {
+          glm::vec2 uv = texCoord - glm::floor(texCoord);
+          auto x0 = (int) std::floor(uv.x * (float) texture.width - 0.5f), y0 = (int) std::floor(uv.y * (float) texture.height - 0.5f);
+          for (int i = 0; i < 4; i++) {
+            int x = (x0 + (i & 1) + texture.width) % texture.width, y = (y0 + (i >> 1) + texture.height) % texture.height;
+            auto line = (int64_t) (sampler.index(0, x, y) * sizeof(ppgso::Image::Pixel) / 64);
+            auto &slot = cache[line % cacheLines];
+            misses += slot != line;
+            slot = line;
+          }
+        });
 
-  // Fill the vector of Faces with data
-  std::vector<Face> faces(mesh.indices.size() / 3);
-  for (int i = 0; i < (int) faces.size(); i++) {
-    faces[i] = Face{
-        {
-            positions[mesh.indices[i * 3]],
-            normals[mesh.indices[i * 3]],
-            texcoords[mesh.indices[i * 3]],
-            {1, 1, 1, 1}
-        }, {
-            positions[mesh.indices[i * 3 + 1]],
-            normals[mesh.indices[i * 3 + 1]],
-            texcoords[mesh.indices[i * 3 + 1]],
-            {1, 1, 1, 1}
-        }, {
-            positions[mesh.indices[i * 3 + 2]],
-            normals[mesh.indices[i * 3 + 2]],
-            texcoords[mesh.indices[i * 3 + 2]],
-            {1, 1, 1, 1}
-        }
-    };
+        std::stringstream name;
+        name << layout.first << ", " << angle << " degrees, " << (blocks ? "8x8 blocks" : "rows");
+        std::cout << "  " << std::setw(46) << std::left << name.str() << std::right << std::setw(8) << time / frames << " ms"
+                  << std::setw(8) << (double) misses / ((double) size * size) << " misses per pixel" << std::endl;
+      }
   }
-  return faces;
-};
+}
 
-int main() {
+int main(int argc, char *argv[]) {
   // Image to store the rendering to
   ppgso::Image image{512, 512};
-  // Vector of faces loaded from Wavefront obj file
-  auto faces = loadObjFile("corsair.obj");
+  // Indexed mesh loaded from Wavefront obj file
+  auto mesh = loadObjFile("corsair.obj");
   // Image to use as texture in the shader program
-  ppgso::Image texture{ppgso::image::loadBMP("corsair.bmp")};
+  ppgso::Image textureImage{ppgso::image::loadBMP("corsair.bmp")};
+  // Trilinear filtered sampler of the texture, without mip mapping only the full resolution level is used
+  ppgso::Sampler texture{textureImage};
   // Shader program to use
-  Program program{texture};
+  TextureProgram program{texture};
   // Set program uniforms
   program.modelMatrix = orientate4(glm::vec3{0,0.4,.8});
   program.viewMatrix = lookAt(glm::vec3{0,.7,.7}, glm::vec3{0,0,0}, glm::vec3{.5, .5, 0});
-  program.projectionMatrix = glm::perspective((ppgso::PI / 180.f) * 60.0f, (float)image.width / (float)image.height, 1.0f, 15.0f);
+  program.projectionMatrix = glm::perspective((ppgso::PI / 180.f) * 60.0f, (float)image.width / (float)image.height, 0.1f, 15.0f);
+
+  if (argc > 1 && std::string{argv[1]} == "benchmark") {
+    // Program variant that interpolates only normals, uses the same transformations
+    NormalProgram normalProgram;
+    static_cast<Transformation &>(normalProgram) = program;
+    // Lit program supporting deferred shading, the only material uses the same texture
+    MaterialProgram materialProgram{{&texture}};
+    static_cast<Transformation &>(materialProgram) = program;
+
+    // Texture larger than the caches repeating the corsair texture
+    ppgso::Image largeTexture{2048, 2048};
+    for (int y = 0; y < largeTexture.height; y += textureImage.height)
+      for (int x = 0; x < largeTexture.width; x += textureImage.width)
+        largeTexture.blit(textureImage, 0, 0, textureImage.width, textureImage.height, x, y);
+    benchmarkLayouts(largeTexture, 1024);
+
+    bool identical = true;
+    for (int size : {512, 1024, 2048}) {
+      identical &= benchmark("texture program", mesh, program, size);
+      identical &= benchmark("normal program", mesh, normalProgram, size);
+      identical &= benchmark("material program", mesh, materialProgram, size);
+    }
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (argc > 1 && std::string{argv[1]} == "realtime") {
+    // The same image is rendered and uploaded as a texture every frame
+    RealtimeWindow window{mesh, program, image.width, image.height, 4};
+    while (window.pollEvents()) {}
+    return EXIT_SUCCESS;
+  }
+
+  // Rasterizer instance specialized for the program, anti-aliased with 4 samples per pixel
+  Rasterizer<TextureProgram> rasterizer{image, program, 4};
 
-  // Rasterizer instance
-  Rasterizer rasterizer{image, program};
+  // Render all faces of the mesh
+  rasterizer.render(mesh);
 
-  // Render all faces
-  for (auto &face : faces)
-    rasterizer.render(face);
+  // Report how many faces reached the rasterizer
+  auto &statistics = rasterizer.statistics;
+  std::cout << "Vertices: " << mesh.vertices.size() << ", transformed: " << statistics.vertices << std::endl;
+  std::cout << "Faces: " << mesh.faceCount() << ", visible: " << statistics.visible << ", clipped: " << statistics.clipped
+            << ", outside: " << statistics.outside << ", culled: " << statistics.culled << ", degenerate: " << statistics.degenerate
+            << ", rasterized triangles: " << statistics.triangles << std::endl;
 
   // Save the image
   ppgso::image::saveBMP(image, "raw4_raster.bmp");
@@ -0,0 +1,79 @@
+#include <iomanip>
+#include <sstream>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <shaders/texture_vert_glsl.h>
+#include <shaders/texture_frag_glsl.h>
+
+#include "realtime.h"
+
+// Interval of frame time readouts in seconds
+const double REPORT_INTERVAL = 0.5;
+
+RealtimeWindow::RealtimeWindow(const Mesh &mesh, TextureProgram &textureProgram, int width, int height, int samples)
+    : ppgso::Window{"raw4_raster", width, height},
+      program{texture_vert_glsl, texture_frag_glsl}, quad{"quad.obj"}, texture{width, height},
+      mesh(mesh), textureProgram(textureProgram), rasterizer{texture.image, textureProgram, samples},
+      modelMatrix{textureProgram.modelMatrix} {
+  // Display the texture on a screen aligned quad
+  program.setUniform("Texture", texture);
+  program.setUniform("ModelMatrix", glm::mat4{1.0f});
+  program.setUniform("ViewMatrix", glm::mat4{1.0f});
+  program.setUniform("ProjectionMatrix", glm::mat4{1.0f});
+
+  // Measure the rasterizer, not the display refresh rate
+  fpsLimit(false);
+  lastReport = glfwGetTime();
+}
+
+void RealtimeWindow::onIdle() {
+  // Spin the model around its vertical axis
+  auto time = glfwGetTime();
+  textureProgram.modelMatrix = glm::rotate(modelMatrix, (float) time * 0.5f, glm::vec3{0, 1, 0});
+
+  // Render the frame into the texture image and upload it
+  auto start = glfwGetTime();
+  rasterizer.clear();
+  rasterizer.render(mesh);
+  rasterTime += glfwGetTime() - start;
+  texture.update();
+
+  frames++;
+  auto now = glfwGetTime();
+  if (now - lastReport >= REPORT_INTERVAL)
+    report(now);
+
+  glClearColor(.5f, .5f, .5f, 0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  quad.render();
+}
+
+void RealtimeWindow::report(double now) {
+  std::stringstream title;
+  title << std::fixed << std::setprecision(2) << "raw4_raster - " << rasterTime * 1000.0 / frames << " ms raster, "
+        << std::setprecision(1) << frames / (now - lastReport) << " fps"
+        << (rasterizer.multithreaded ? ", threads" : "") << (rasterizer.quadShading ? ", quads" : "")
+        << (rasterizer.hierarchicalZ ? ", hier. Z" : "") << (textureProgram.mipmapping ? ", mip maps" : "")
+        << ", " << rasterizer.pool.getStatistics().misses << " buffer allocations";
+  glfwSetWindowTitle(window, title.str().c_str());
+
+  rasterTime = 0;
+  frames = 0;
+  lastReport = now;
+}
+
+void RealtimeWindow::onKey(int key, int scanCode, int action, int mods) {
+  if (action != GLFW_PRESS) return;
+
+  switch (key) {
+    case GLFW_KEY_T: rasterizer.multithreaded = !rasterizer.multithreaded; break;
+    case GLFW_KEY_Q: rasterizer.quadShading = !rasterizer.quadShading; break;
+    case GLFW_KEY_H: rasterizer.hierarchicalZ = !rasterizer.hierarchicalZ; break;
+    case GLFW_KEY_M: textureProgram.mipmapping = !textureProgram.mipmapping; break;
+    default: return;
+  }
+  // Start a new readout with the changed settings
+  rasterTime = 0;
+  frames = 0;
+  lastReport = glfwGetTime();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <ppgso/ppgso.h>
+
+#include "rasterizer.h"
+
+/*!
+ * Window that rasterizes the mesh on the CPU every frame and displays the image as a texture
+ * The model rotates over time, the title shows the rasterizer time and the frame rate
+ * T toggles multithreading, Q quad shading, H the depth hierarchy and M mip mapping of quads
+ */
+class RealtimeWindow : public ppgso::Window {
+private:
+  ppgso::Shader program;
+  ppgso::Mesh quad;
+  // Texture image is reused as the render target of all frames
+  ppgso::Texture texture;
+
+  const Mesh &mesh;
+  TextureProgram &textureProgram;
+  Rasterizer<TextureProgram> rasterizer;
+  // Model matrix the animation starts from
+  glm::mat4 modelMatrix;
+
+  // Frame times accumulated since the title was last updated
+  double rasterTime = 0, lastReport;
+  int frames = 0;
+
+  /*!
+   * Show the average frame times and the rasterizer settings in the title
+   * @param now Current time in seconds
+   */
+  void report(double now);
+
+public:
+  /*!
+   * Open a window and prepare the rasterizer
+   * @param mesh Mesh to render, must exist as long as the window
+   * @param textureProgram Program to render with, its model matrix is animated
+   * @param width Width of the window and rendered image
+   * @param height Height of the window and rendered image
+   * @param samples Number of samples per pixel, 1 or 4
+   */
+  RealtimeWindow(const Mesh &mesh, TextureProgram &textureProgram, int width, int height, int samples);
+
+  /*!
+   * Render a new frame of the animation and display it
+   */
+  void onIdle() override;
+
+  /*!
+   * Toggle rasterizer settings
+   */
+  void onKey(int key, int scanCode, int action, int mods) override;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*!
+ * Vertex structure to hold per vertex data in
+ */
+struct Vertex {
+  glm::vec4 position;
+  glm::vec4 normal;
+  glm::vec2 texCoord;
+  glm::vec4 color;
+};
+
+/*!
+ * Face structure to hold three vertices that form a triangle/face
+ */
+struct Face {
+  Vertex v0, v1, v2;
+};
+
+/*!
+ * Indexed mesh, vertices shared by several faces are stored and transformed only once
+ */
+struct Mesh {
+  std::vector<Vertex> vertices;
+  // Three vertex indices for each face
+  std::vector<uint32_t> indices;
+
+  /*!
+   * Number of faces in the mesh
+   */
+  size_t faceCount() const {
+    return indices.size() / 3;
+  }
+
+  /*!
+   * Copy the vertices of a face out of the mesh
+   * @param face Index of the face
+   * @return Face with its three vertices
+   */
+  Face face(size_t face) const {
+    return Face{vertices[indices[face * 3]], vertices[indices[face * 3 + 1]], vertices[indices[face * 3 + 2]]};
+  }
+};
+
+/*!
+ * Varyings are shader specific structures of floats and float vectors, the rasterizer interpolates them component by component
+ * The number of components is known at compile time so all loops over them can be unrolled or vectorized
+ */
+template<typename Varyings>
+struct VaryingTraits {
+  static_assert(std::is_standard_layout<Varyings>::value && sizeof(Varyings) % sizeof(float) == 0,
+                "Varyings must only consist of floats and float vectors");
+
+  // Number of floats in the varyings
+  static const int COMPONENTS = sizeof(Varyings) / sizeof(float);
+
+  /*!
+   * Access the varyings as an array of components
+   */
+  static float *components(Varyings &varyings) {
+    return reinterpret_cast<float *>(&varyings);
+  }
+
+  static const float *components(const Varyings &varyings) {
+    return reinterpret_cast<const float *>(&varyings);
+  }
+};
+
+/*!
+ * Vertex shader output, position in clip space and varyings declared by the shader
+ */
+template<typename Varyings>
+struct ShadedVertex {
+  glm::vec4 position;
+  Varyings varyings;
+};
+
+/*!
+ * Varying interpolation function that combines all components of the varyings of three vertices
+ * @param v0 Varyings of the first vertex
+ * @param v1 Varyings of the second vertex
+ * @param v2 Varyings of the third vertex
+ * @param weights Weights of the vertices, expected to sum up to 1
+ * @return Linear combination of v0, v1 and v2
+ */
+template<typename Varyings>
+inline Varyings interpolate(const Varyings &v0, const Varyings &v1, const Varyings &v2, const glm::vec3 &weights) {
+  using Traits = VaryingTraits<Varyings>;
+  auto a0 = Traits::components(v0), a1 = Traits::components(v1), a2 = Traits::components(v2);
+  Varyings result;
+  auto output = Traits::components(result);
+  for (int i = 0; i < Traits::COMPONENTS; i++)
+    output[i] = a0[i] * weights.x + a1[i] * weights.y + a2[i] * weights.z;
+  return result;
+}
+
+/*!
+ * Linear interpolation of two shaded vertices including their position, used to create new vertices when clipping
+ * @param v0 First vertex
+ * @param v1 Second vertex
+ * @param t Weight of the second vertex
+ * @return Vertex between v0 and v1
+ */
+template<typename Varyings>
+inline ShadedVertex<Varyings> mix(const ShadedVertex<Varyings> &v0, const ShadedVertex<Varyings> &v1, float t) {
+  using Traits = VaryingTraits<Varyings>;
+  auto a0 = Traits::components(v0.varyings), a1 = Traits::components(v1.varyings);
+  ShadedVertex<Varyings> result;
+  result.position = v0.position + (v1.position - v0.position) * t;
+  auto output = Traits::components(result.varyings);
+  for (int i = 0; i < Traits::COMPONENTS; i++)
+    output[i] = a0[i] + (a1[i] - a0[i]) * t;
+  return result;
+}
@@ -0,0 +1,289 @@
+#include <algorithm>
+
+#include "bvh.h"
+
+// Number of bins used to evaluate split candidates along each axis
+const int BINS = 16;
+
+// Levels with less nodes than this are refitted on a single thread
+const size_t PARALLEL_REFIT = 1024;
+
+AABB AABB::transform(const glm::dmat4 &matrix) const {
+  AABB result;
+  if (empty()) return result;
+  for (int i = 0; i < 8; i++) {
+    glm::dvec3 corner{i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z};
+    result.grow(glm::dvec3{matrix * glm::dvec4{corner, 1.0}});
+  }
+  return result;
+}
+
+/*!
+ * Number of halvings needed to get down to a single primitive
+ */
+static int levelsNeeded(uint32_t count) {
+  int levels = 0;
+  while ((1ull << levels) < count) levels++;
+  return levels;
+}
+
+/*!
+ * Compute centroids of all primitive bounds
+ */
+static std::vector<glm::dvec3> computeCentroids(const std::vector<AABB> &bounds) {
+  std::vector<glm::dvec3> centroids(bounds.size());
+  for (size_t i = 0; i < bounds.size(); i++)
+    centroids[i] = bounds[i].centroid();
+  return centroids;
+}
+
+void BVH::build(const std::vector<AABB> &bounds, unsigned int maxLeafSize) {
+  this->maxLeafSize = std::max(1u, maxLeafSize);
+  nodes.clear();
+  buildAreas.clear();
+  indices.resize(bounds.size());
+  if (bounds.empty()) {
+    updateRefitOrder();
+    buildCost = 0;
+    return;
+  }
+
+  for (uint32_t i = 0; i < (uint32_t) bounds.size(); i++)
+    indices[i] = i;
+
+  // Binary tree with at least one primitive per leaf has at most 2N-1 nodes
+  nodes.resize(2 * bounds.size() - 1);
+  buildAreas.resize(nodes.size());
+  uint32_t used = buildNode(bounds, computeCentroids(bounds), 0, 0, (uint32_t) bounds.size(), 0);
+  nodes.resize(used);
+  buildAreas.resize(used);
+  nodes.shrink_to_fit();
+  buildAreas.shrink_to_fit();
+
+  updateRefitOrder();
+  buildCost = cost();
+}
+
+uint32_t BVH::buildNode(const std::vector<AABB> &bounds, const std::vector<glm::dvec3> &centroids, uint32_t nodeIndex, uint32_t first, uint32_t count, int depth) {
+  // Compute node bounds and bounds of centroids
+  AABB nodeBounds, centroidBounds;
+  for (uint32_t i = first; i < first + count; i++) {
+    nodeBounds.grow(bounds[indices[i]]);
+    centroidBounds.grow(centroids[indices[i]]);
+  }
+  nodes[nodeIndex].bounds = nodeBounds;
+  buildAreas[nodeIndex] = nodeBounds.surfaceArea();
+
+  // Small enough to be stored in a leaf
+  if (count <= maxLeafSize) {
+    nodes[nodeIndex].offset = first;
+    nodes[nodeIndex].count = count;
+    return nodeIndex + 1;
+  }
+
+  // Skewed splits can peel off one primitive per level, once only balanced splits still fit under MAX_DEPTH use the median
+  // Traversal keeps at most one pending sibling per level plus both children of the deepest inner node on its stack
+  bool median = depth + levelsNeeded(count) >= MAX_DEPTH - 2;
+
+  // Find the best split using the Surface Area Heuristic evaluated on bin boundaries
+  int bestAxis = -1, bestSplit = 0;
+  double bestCost = INF;
+  glm::dvec3 extent = centroidBounds.max - centroidBounds.min;
+  for (int axis = 0; axis < 3 && !median; axis++) {
+    if (extent[axis] <= 0) continue;
+
+    AABB binBounds[BINS];
+    uint32_t binCounts[BINS] = {};
+    double scale = BINS / extent[axis];
+    for (uint32_t i = first; i < first + count; i++) {
+      int bin = std::min(BINS - 1, (int) ((centroids[indices[i]][axis] - centroidBounds.min[axis]) * scale));
+      binBounds[bin].grow(bounds[indices[i]]);
+      binCounts[bin]++;
+    }
+
+    // Sweep from the right to get areas of all right partitions
+    double rightAreas[BINS];
+    uint32_t rightCounts[BINS];
+    AABB right;
+    uint32_t rightCount = 0;
+    for (int bin = BINS - 1; bin > 0; bin--) {
+      right.grow(binBounds[bin]);
+      rightCount += binCounts[bin];
+      rightAreas[bin] = right.surfaceArea();
+      rightCounts[bin] = rightCount;
+    }
+
+    // Sweep from the left and evaluate the cost of each split
+    AABB left;
+    uint32_t leftCount = 0;
+    for (int split = 1; split < BINS; split++) {
+      left.grow(binBounds[split - 1]);
+      leftCount += binCounts[split - 1];
+      if (leftCount == 0 || rightCounts[split] == 0) continue;
+      double cost = leftCount * left.surfaceArea() + rightCounts[split] * rightAreas[split];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = split;
+      }
+    }
+  }
+
+  // Partition the indices according to the chosen split
+  uint32_t *begin = indices.data() + first;
+  uint32_t *end = begin + count;
+  uint32_t *middle;
+  if (median) {
+    // Split in the middle of the centroids sorted along the longest axis
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+    middle = begin + count / 2;
+    std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) {
+      return centroids[a][axis] < centroids[b][axis];
+    });
+  } else if (bestAxis >= 0) {
+    double scale = BINS / extent[bestAxis];
+    double minimum = centroidBounds.min[bestAxis];
+    middle = std::partition(begin, end, [&](uint32_t index) {
+      return std::min(BINS - 1, (int) ((centroids[index][bestAxis] - minimum) * scale)) < bestSplit;
+    });
+  } else {
+    // All centroids are in the same spot, split in the middle
+    middle = begin + count / 2;
+  }
+  auto leftCount = (uint32_t) (middle - begin);
+
+  // Build children, the left child immediately follows this node
+  uint32_t rightIndex = buildNode(bounds, centroids, nodeIndex + 1, first, leftCount, depth + 1);
+  uint32_t next = buildNode(bounds, centroids, rightIndex, first + leftCount, count - leftCount, depth + 1);
+
+  nodes[nodeIndex].offset = rightIndex;
+  nodes[nodeIndex].count = 0;
+  return next;
+}
+
+void BVH::updateRefitOrder() {
+  // Compute depth of each inner node
+  std::vector<std::vector<uint32_t>> levels;
+  std::vector<std::pair<uint32_t, size_t>> stack;
+  if (!nodes.empty()) stack.emplace_back(0, 0);
+  while (!stack.empty()) {
+    auto item = stack.back();
+    stack.pop_back();
+    auto &node = nodes[item.first];
+    if (node.count > 0) continue;
+    if (levels.size() <= item.second) levels.resize(item.second + 1);
+    levels[item.second].push_back(item.first);
+    stack.emplace_back(item.first + 1, item.second + 1);
+    stack.emplace_back(node.offset, item.second + 1);
+  }
+
+  // Store levels starting from the deepest one
+  refitOrder.clear();
+  levelOffsets.clear();
+  for (auto level = levels.rbegin(); level != levels.rend(); ++level) {
+    levelOffsets.push_back(refitOrder.size());
+    refitOrder.insert(refitOrder.end(), level->begin(), level->end());
+  }
+  levelOffsets.push_back(refitOrder.size());
+}
+
+void BVH::refit(const std::vector<AABB> &bounds) {
+  // Leaves are independent of each other
+  #pragma omp parallel for if (nodes.size() > PARALLEL_REFIT)
+  for (int i = 0; i < (int) nodes.size(); i++) {
+    auto &node = nodes[i];
+    if (node.count == 0) continue;
+    AABB box;
+    for (uint32_t j = node.offset; j < node.offset + node.count; j++)
+      box.grow(bounds[indices[j]]);
+    node.bounds = box;
+  }
+
+  // Inner nodes only depend on their children which are always one level deeper
+  for (size_t level = 0; level + 1 < levelOffsets.size(); level++) {
+    auto begin = (int) levelOffsets[level];
+    auto end = (int) levelOffsets[level + 1];
+    #pragma omp parallel for if ((size_t) (end - begin) > PARALLEL_REFIT)
+    for (int i = begin; i < end; i++) {
+      uint32_t index = refitOrder[i];
+      auto &node = nodes[index];
+      AABB box = nodes[index + 1].bounds;
+      box.grow(nodes[node.offset].bounds);
+      node.bounds = box;
+    }
+  }
+}
+
+uint32_t BVH::rebuildNode(const std::vector<AABB> &bounds, const std::vector<glm::dvec3> &centroids, uint32_t nodeIndex, int depth) {
+  // Leaves of a subtree reference a continuous range of indices
+  uint32_t leftmost = nodeIndex, rightmost = nodeIndex;
+  while (nodes[leftmost].count == 0) leftmost = leftmost + 1;
+  while (nodes[rightmost].count == 0) rightmost = nodes[rightmost].offset;
+  uint32_t first = nodes[leftmost].offset;
+  uint32_t count = nodes[rightmost].offset + nodes[rightmost].count - first;
+
+  // With single primitive leaves the subtree always has 2N-1 nodes so it fits in its old place
+  buildNode(bounds, centroids, nodeIndex, first, count, depth);
+  return count;
+}
+
+size_t BVH::update(const std::vector<AABB> &bounds, double threshold) {
+  refit(bounds);
+  if (degradation() <= threshold) return 0;
+
+  // Subtrees can only be rebuilt in place when leaves hold single primitives
+  if (maxLeafSize > 1) {
+    build(bounds, maxLeafSize);
+    return bounds.size();
+  }
+
+  // Rebuild topmost subtrees whose surface area grew over the threshold
+  auto centroids = computeCentroids(bounds);
+  size_t rebuilt = 0;
+  std::vector<std::pair<uint32_t, int>> stack{{0, 0}};
+  while (!stack.empty()) {
+    uint32_t index = stack.back().first;
+    int depth = stack.back().second;
+    stack.pop_back();
+    auto &node = nodes[index];
+    if (node.count > 0) continue;
+
+    if (node.bounds.surfaceArea() > buildAreas[index] * threshold) {
+      if (index == 0) break;
+      rebuilt += rebuildNode(bounds, centroids, index, depth);
+      continue;
+    }
+    stack.emplace_back(node.offset, depth + 1);
+    stack.emplace_back(index + 1, depth + 1);
+  }
+
+  // The whole tree degraded or the degradation is spread evenly, rebuild everything
+  if (rebuilt == 0) {
+    build(bounds, maxLeafSize);
+    return bounds.size();
+  }
+
+  // Topology of the rebuilt subtrees changed, update the ancestors, buildNode already reset the build areas of the subtrees
+  updateRefitOrder();
+  refit(bounds);
+
+  // Cost is still measured against the last full build so a series of partial rebuilds cannot let the tree decay
+  if (degradation() > threshold) {
+    build(bounds, maxLeafSize);
+    return bounds.size();
+  }
+  return rebuilt;
+}
+
+double BVH::cost() const {
+  if (nodes.empty()) return 0;
+  double rootArea = nodes[0].bounds.surfaceArea();
+  if (rootArea <= 0) return 0;
+
+  double total = 0;
+  for (auto &node : nodes)
+    total += node.bounds.surfaceArea() * (node.count > 0 ? node.count : 1);
+  return total / rootArea;
+}
@@ -0,0 +1,239 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "ray.h"
+
+/*!
+ * Axis aligned bounding box defined by its minimal and maximal corner
+ */
+struct AABB {
+  glm::dvec3 min{INF, INF, INF}, max{-INF, -INF, -INF};
+
+  /*!
+   * Extend the box so it contains the point
+   * @param point Point to include
+   */
+  inline void grow(const glm::dvec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  /*!
+   * Extend the box so it contains another box
+   * @param box Box to include
+   */
+  inline void grow(const AABB &box) {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+
+  /*!
+   * @return True when the box does not contain anything
+   */
+  inline bool empty() const {
+    return min.x > max.x;
+  }
+
+  /*!
+   * @return Center point of the box
+   */
+  inline glm::dvec3 centroid() const {
+    return (min + max) * 0.5;
+  }
+
+  /*!
+   * Surface area of the box, used as a probability of a ray hit in the Surface Area Heuristic
+   * @return Surface area or 0 for empty boxes
+   */
+  inline double surfaceArea() const {
+    if (empty()) return 0;
+    glm::dvec3 d = max - min;
+    return 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+
+  /*!
+   * Compute bounding box of this box transformed by a matrix
+   * @param matrix Transformation to apply to all 8 corners of the box
+   * @return Box containing the transformed box
+   */
+  AABB transform(const glm::dmat4 &matrix) const;
+
+  /*!
+   * Ray to box intersection using the slab method
+   * @param ray Ray to test
+   * @param inverseDirection Precomputed 1/ray.direction
+   * @param maxDistance Ignore intersections further than this distance
+   * @return Distance to the box entry point or INF when the box was missed
+   */
+  inline double intersect(const Ray &ray, const glm::dvec3 &inverseDirection, double maxDistance) const {
+    glm::dvec3 t0 = (min - ray.origin) * inverseDirection;
+    glm::dvec3 t1 = (max - ray.origin) * inverseDirection;
+    glm::dvec3 tNear = glm::min(t0, t1);
+    glm::dvec3 tFar = glm::max(t0, t1);
+    double entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0));
+    double exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return entry <= exit ? entry : INF;
+  }
+};
+
+/*!
+ * Bounding Volume Hierarchy over a set of primitives that are only known by their bounding boxes
+ * The same structure is used for triangles/spheres inside a shape (bottom level)
+ * and for shape instances in the world (top level)
+ */
+class BVH {
+public:
+  /*!
+   * Node of the hierarchy, nodes are stored in depth first order so the left child always follows its parent
+   */
+  struct Node {
+    AABB bounds;
+    uint32_t offset; // Index of the right child for inner nodes, first index into indices for leaves
+    uint32_t count;  // Number of primitives in a leaf, 0 for inner nodes
+  };
+
+  // Nodes of the hierarchy, first node is the root
+  std::vector<Node> nodes;
+  // Primitive indices referenced by leaves
+  std::vector<uint32_t> indices;
+
+  // Size of the traversal stack, the build keeps the depth of every leaf below it
+  static const int MAX_DEPTH = 64;
+
+  /*!
+   * Build the hierarchy using binned Surface Area Heuristic
+   * @param bounds Bounding boxes of all primitives
+   * @param maxLeafSize Maximal number of primitives stored in one leaf
+   */
+  void build(const std::vector<AABB> &bounds, unsigned int maxLeafSize);
+
+  /*!
+   * Update node bounds bottom up after primitives moved, the tree topology stays the same
+   * Nodes on the same depth are independent so each level is refitted in parallel
+   * @param bounds New bounding boxes of all primitives, the number of primitives must not change
+   */
+  void refit(const std::vector<AABB> &bounds);
+
+  /*!
+   * Refit the hierarchy and rebuild the parts that degraded too much
+   * Subtrees are rebuilt in place when every leaf holds a single primitive, otherwise the whole tree is rebuilt
+   * @param bounds New bounding boxes of all primitives, the number of primitives must not change
+   * @param threshold Allowed growth of the SAH cost compared to the last full build and of node surface area compared to the build of the node
+   * @return Number of primitives that had to be rebuilt, 0 when refit was sufficient
+   */
+  size_t update(const std::vector<AABB> &bounds, double threshold);
+
+  /*!
+   * Surface Area Heuristic cost of the tree normalized by the root area, lower is better
+   * @return Expected number of node visits and primitive tests for a random ray hitting the root
+   */
+  double cost() const;
+
+  /*!
+   * Quality metric of a refitted tree
+   * @return SAH cost relative to the cost right after the last full build, 1 means no degradation
+   */
+  double degradation() const {
+    return buildCost > 0 ? cost() / buildCost : 1.0;
+  }
+
+  /*!
+   * @return Bounding box of the whole hierarchy
+   */
+  AABB bounds() const {
+    return nodes.empty() ? AABB{} : nodes[0].bounds;
+  }
+
+  /*!
+   * @return Memory used by the hierarchy in bytes
+   */
+  size_t memoryUsage() const {
+    return nodes.size() * (sizeof(Node) + sizeof(double)) + indices.size() * sizeof(uint32_t) + refitOrder.size() * sizeof(uint32_t);
+  }
+
+  /*!
+   * Traverse the hierarchy front to back and call intersect for each primitive in leaves the ray reaches
+   * @param ray Ray to traverse with
+   * @param maxDistance Closest distance found so far, intersect is expected to shorten it on hits
+   * @param intersect Callable bool(uint32_t primitive, double &maxDistance) that returns true on a hit
+   * @param anyHit Stop at the first hit, useful for shadow rays
+   * @return True if any primitive was hit
+   */
+  template<typename Intersect>
+  bool traverse(const Ray &ray, double &maxDistance, Intersect &&intersect, bool anyHit = false) const {
+    if (nodes.empty()) return false;
+
+    glm::dvec3 inverseDirection = 1.0 / ray.direction;
+    bool hit = false;
+
+    uint32_t stack[MAX_DEPTH];
+    int top = 0;
+    if (nodes[0].bounds.intersect(ray, inverseDirection, maxDistance) >= INF) return false;
+    stack[top++] = 0;
+
+    while (top > 0) {
+      uint32_t index = stack[--top];
+      const Node &node = nodes[index];
+
+      if (node.count > 0) {
+        // Leaf, test all primitives
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+          if (intersect(indices[i], maxDistance)) {
+            hit = true;
+            if (anyHit) return true;
+          }
+        }
+        continue;
+      }
+
+      // Inner node, visit the closer child first
+      uint32_t left = index + 1;
+      uint32_t right = node.offset;
+      double leftDistance = nodes[left].bounds.intersect(ray, inverseDirection, maxDistance);
+      double rightDistance = nodes[right].bounds.intersect(ray, inverseDirection, maxDistance);
+      if (leftDistance > rightDistance) {
+        std::swap(left, right);
+        std::swap(leftDistance, rightDistance);
+      }
+      if (rightDistance < INF) stack[top++] = right;
+      if (leftDistance < INF) stack[top++] = left;
+    }
+    return hit;
+  }
+
+private:
+  unsigned int maxLeafSize = 1;
+  // SAH cost right after the last full build, partial rebuilds keep it
+  double buildCost = 0;
+  // Surface area of each node right after it was built
+  std::vector<double> buildAreas;
+  // Inner nodes grouped by depth starting with the deepest level, levelOffsets mark where each level starts
+  std::vector<uint32_t> refitOrder;
+  std::vector<size_t> levelOffsets;
+
+  /*!
+   * Recursively build a node and its children for a range of indices
+   * The node is written to nodeIndex and its subtree is stored right after it in depth first order
+   * Falls back to median splits when skewed SAH splits would make the subtree deeper than MAX_DEPTH
+   * @return Index following the last node of the subtree
+   */
+  uint32_t buildNode(const std::vector<AABB> &bounds, const std::vector<glm::dvec3> &centroids, uint32_t nodeIndex, uint32_t first, uint32_t count, int depth);
+
+  /*!
+   * Rebuild the subtree of a node in place, only possible when each leaf holds a single primitive
+   * @param bounds Bounding boxes of all primitives
+   * @param centroids Centroids of all primitives
+   * @param nodeIndex Root of the subtree to rebuild
+   * @param depth Depth of the node in the tree
+   * @return Number of primitives in the subtree
+   */
+  uint32_t rebuildNode(const std::vector<AABB> &bounds, const std::vector<glm::dvec3> &centroids, uint32_t nodeIndex, int depth);
+
+  /*!
+   * Group inner nodes by depth so refit can process each level in parallel
+   */
+  void updateRefitOrder();
+};
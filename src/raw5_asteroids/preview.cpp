@@ -0,0 +1,177 @@
+#include <sstream>
+
+#include <shaders/texture_vert_glsl.h>
+#include <shaders/texture_frag_glsl.h>
+
+#include "preview.h"
+
+// Size of tiles in pixels
+const int TILE_SIZE = 32;
+
+// Number of reduced resolution passes, the first pass uses 2^PREVIEW_LEVELS sized pixel blocks
+const int PREVIEW_LEVELS = 3;
+
+// Stop refining after this many samples per pixel
+const unsigned int MAX_SAMPLES = 1024;
+
+ProgressiveRenderer::ProgressiveRenderer(const World &world, const Camera &camera, int width, int height, unsigned int depth)
+    : world(world), width{width}, height{height}, depth{depth}, accumulation{width, height}, camera(camera) {
+  for (int y = 0; y < height; y += TILE_SIZE)
+    for (int x = 0; x < width; x += TILE_SIZE)
+      tiles.push_back({x, y, std::min(TILE_SIZE, width - x), std::min(TILE_SIZE, height - y)});
+
+  tileSamples.resize(tiles.size());
+  tileLocks = std::vector<std::mutex>(tiles.size());
+  tileChanged = std::vector<std::atomic<bool>>(tiles.size());
+
+  thread = std::thread{&ProgressiveRenderer::run, this};
+}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+  running = false;
+  thread.join();
+}
+
+void ProgressiveRenderer::restart(const Camera &camera) {
+  std::lock_guard<std::mutex> lock{cameraLock};
+  this->camera = camera;
+  generation++;
+  completedSamples = 0;
+}
+
+void ProgressiveRenderer::run() {
+  unsigned int currentGeneration = generation - 1;
+  unsigned int pass = 0;
+  Camera currentCamera{};
+
+  while (running) {
+    // Pick up camera changes, restarting only resets the pass counter
+    if (currentGeneration != generation) {
+      std::lock_guard<std::mutex> lock{cameraLock};
+      currentCamera = camera;
+      currentGeneration = generation;
+      pass = 0;
+    }
+
+    // Nothing more to do until the next restart
+    if (completedSamples >= MAX_SAMPLES) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+      continue;
+    }
+
+    // Coarse passes replace the previous result, full resolution passes accumulate
+    int level = pass < PREVIEW_LEVELS ? PREVIEW_LEVELS - (int) pass : 0;
+    bool accumulate = pass > PREVIEW_LEVELS;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int) tiles.size(); i++) {
+      if (!running || currentGeneration != generation) continue;
+      renderTile((size_t) i, currentCamera, 1 << level, accumulate, currentGeneration);
+    }
+
+    // Checked under the camera lock so a restart in between cannot have its reset overwritten with the old sample count
+    std::lock_guard<std::mutex> lock{cameraLock};
+    if (currentGeneration != generation) continue;
+    pass++;
+    if (pass > PREVIEW_LEVELS) completedSamples = pass - PREVIEW_LEVELS;
+  }
+}
+
+void ProgressiveRenderer::renderTile(size_t tile, const Camera &camera, int blockSize, bool accumulate, unsigned int renderGeneration) {
+  auto &t = tiles[tile];
+  glm::vec3 colors[TILE_SIZE * TILE_SIZE];
+
+  // Trace one ray per block and fill the whole block with its color
+  for (int by = 0; by < t.height; by += blockSize) {
+    for (int bx = 0; bx < t.width; bx += blockSize) {
+      // Coarse blocks cover more pixels so the texture footprint grows with them
+      RayDifferential differential;
+      auto ray = camera.generateRay(t.x + bx, t.y + by, width, height, differential);
+      differential.dDdx *= (double) blockSize;
+      differential.dDdy *= (double) blockSize;
+      glm::vec3 color = world.trace(ray, differential, depth);
+      for (int y = by; y < std::min(by + blockSize, t.height); y++)
+        for (int x = bx; x < std::min(bx + blockSize, t.width); x++)
+          colors[x + y * TILE_SIZE] = color;
+    }
+  }
+
+  // Drop the result if the camera moved in the meantime, restart does not take the tile locks so a tile of the old camera
+  // can still be written right after it, that is harmless as the first pass after a restart replaces every tile before accumulating
+  std::lock_guard<std::mutex> lock{tileLocks[tile]};
+  if (renderGeneration != generation) return;
+
+  for (int y = 0; y < t.height; y++) {
+    for (int x = 0; x < t.width; x++) {
+      auto &pixel = accumulation.getPixel(t.x + x, t.y + y);
+      pixel = accumulate ? pixel + colors[x + y * TILE_SIZE] : colors[x + y * TILE_SIZE];
+    }
+  }
+  tileSamples[tile] = accumulate ? tileSamples[tile] + 1 : 1;
+  tileChanged[tile] = true;
+}
+
+std::vector<ProgressiveRenderer::Tile> ProgressiveRenderer::collect(ppgso::Image &image) {
+  std::vector<Tile> changed;
+  for (size_t i = 0; i < tiles.size(); i++) {
+    if (!tileChanged[i].exchange(false)) continue;
+
+    auto &t = tiles[i];
+    std::lock_guard<std::mutex> lock{tileLocks[i]};
+    float scale = 1.0f / (float) tileSamples[i];
+    for (int y = t.y; y < t.y + t.height; y++) {
+      for (int x = t.x; x < t.x + t.width; x++) {
+        auto color = accumulation.getPixel(x, y) * scale;
+        image.setPixel(x, y, color.r, color.g, color.b);
+      }
+    }
+    changed.push_back(t);
+  }
+  return changed;
+}
+
+PreviewWindow::PreviewWindow(const World &world, int width, int height)
+    : ppgso::Window{"raw5_asteroids", width, height},
+      program{texture_vert_glsl, texture_frag_glsl}, quad{"quad.obj"}, texture{width, height},
+      camera(world.camera), renderer{world, world.camera, width, height, 3} {
+  // Display the texture on a screen aligned quad
+  program.setUniform("Texture", texture);
+  program.setUniform("ModelMatrix", glm::mat4{1.0f});
+  program.setUniform("ViewMatrix", glm::mat4{1.0f});
+  program.setUniform("ProjectionMatrix", glm::mat4{1.0f});
+}
+
+void PreviewWindow::onIdle() {
+  // Only upload tiles that changed since the last frame
+  for (auto &tile : renderer.collect(texture.image))
+    texture.update(tile.x, tile.y, tile.width, tile.height);
+
+  // Show progress in the title
+  if (renderer.samples() != shownSamples) {
+    shownSamples = renderer.samples();
+    std::stringstream title;
+    title << "raw5_asteroids - " << shownSamples << " samples";
+    glfwSetWindowTitle(window, title.str().c_str());
+  }
+
+  glClearColor(.5f, .5f, .5f, 0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  quad.render();
+}
+
+void PreviewWindow::onKey(int key, int scanCode, int action, int mods) {
+  if (action == GLFW_RELEASE) return;
+
+  const double step = 2.0;
+  glm::dvec3 right = normalize(camera.right), up = normalize(camera.up), back = normalize(camera.back);
+  switch (key) {
+    case GLFW_KEY_LEFT: camera.position -= right * step; break;
+    case GLFW_KEY_RIGHT: camera.position += right * step; break;
+    case GLFW_KEY_UP: camera.position += up * step; break;
+    case GLFW_KEY_DOWN: camera.position -= up * step; break;
+    case GLFW_KEY_W: camera.position -= back * step; break;
+    case GLFW_KEY_S: camera.position += back * step; break;
+    default: return;
+  }
+  renderer.restart(camera);
+}
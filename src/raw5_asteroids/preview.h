@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <ppgso/ppgso.h>
+
+#include "world.h"
+
+/*!
+ * Progressive renderer that keeps refining an image of the world on a background thread
+ * The first passes render at reduced resolution so something appears quickly, after that
+ * each pass adds one sample per pixel into a float accumulation buffer
+ */
+class ProgressiveRenderer {
+public:
+  /*!
+   * Rectangular part of the image that is rendered and uploaded as a unit
+   */
+  struct Tile {
+    int x, y, width, height;
+  };
+
+  /*!
+   * Start rendering the world on a background thread
+   * @param world World to render, must not change while the renderer exists
+   * @param camera Initial camera
+   * @param width Width of the rendered image
+   * @param height Height of the rendered image
+   * @param depth Maximum number of reflections to trace
+   */
+  ProgressiveRenderer(const World &world, const Camera &camera, int width, int height, unsigned int depth);
+
+  ~ProgressiveRenderer();
+
+  /*!
+   * Restart the accumulation with a new camera, this does not wait for the renderer
+   * @param camera Camera to use from now on
+   */
+  void restart(const Camera &camera);
+
+  /*!
+   * Resolve tiles that changed since the last call into the image
+   * @param image Image to write to, needs to have the size of the renderer
+   * @return Tiles that were written to the image
+   */
+  std::vector<Tile> collect(ppgso::Image &image);
+
+  /*!
+   * @return Number of completed full resolution samples per pixel
+   */
+  unsigned int samples() const {
+    return completedSamples;
+  }
+
+private:
+  const World &world;
+  int width, height;
+  unsigned int depth;
+
+  // Tiles and their accumulation state, each tile is guarded by its own lock
+  std::vector<Tile> tiles;
+  ppgso::ImageRGB32F accumulation;
+  std::vector<unsigned int> tileSamples;
+  std::vector<std::mutex> tileLocks;
+  std::vector<std::atomic<bool>> tileChanged;
+
+  // Camera requested by restart, generation is increased on each restart
+  // Both generation and completedSamples are only written under cameraLock so a finished pass cannot report samples of an old camera
+  std::mutex cameraLock;
+  Camera camera;
+  std::atomic<unsigned int> generation{0};
+  std::atomic<unsigned int> completedSamples{0};
+
+  std::atomic<bool> running{true};
+  std::thread thread;
+
+  /*!
+   * Render loop running on the background thread
+   */
+  void run();
+
+  /*!
+   * Render a single tile and store the result into the accumulation buffer
+   * @param tile Index of the tile to render
+   * @param camera Camera to render with
+   * @param blockSize Size of pixel blocks that share a single sample, 1 for full resolution
+   * @param accumulate Add to previous samples instead of replacing them
+   * @param renderGeneration Generation the tile is rendered for, results are dropped after restart
+   */
+  void renderTile(size_t tile, const Camera &camera, int blockSize, bool accumulate, unsigned int renderGeneration);
+};
+
+/*!
+ * Window that displays the progressive rendering of the world
+ * The camera can be moved using arrow keys, W and S, each move restarts the rendering
+ */
+class PreviewWindow : public ppgso::Window {
+private:
+  ppgso::Shader program;
+  ppgso::Mesh quad;
+  ppgso::Texture texture;
+  Camera camera;
+  ProgressiveRenderer renderer;
+  unsigned int shownSamples = 0;
+
+public:
+  /*!
+   * Open a window and start rendering the world
+   * @param world World to render
+   * @param width Width of the window and rendered image
+   * @param height Height of the window and rendered image
+   */
+  PreviewWindow(const World &world, int width, int height);
+
+  /*!
+   * Upload changed tiles and display the texture
+   */
+  void onIdle() override;
+
+  /*!
+   * Move the camera
+   */
+  void onKey(int key, int scanCode, int action, int mods) override;
+};
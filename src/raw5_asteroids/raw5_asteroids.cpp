@@ -0,0 +1,290 @@
+// Example raw5_asteroids
+// - Raytraces a large asteroid field similar to the gl9_scene example
+// - Geometry is loaded once and shared by many instances, each instance only stores its transformation and material
+// - Uses a two level Bounding Volume Hierarchy, top level over instances and bottom level per shared shape
+// - Ray differentials select the mip level of textures so distant asteroids are filtered instead of aliased
+// - Run with "benchmark" argument to compare BVH refit with full rebuild on a moving asteroid sequence
+// - Run with "tiled WIDTH HEIGHT FILE" arguments to render huge images in bands that are streamed to a BMP or RAW file
+// - Run with "preview" argument to open a window that progressively refines the image while the camera can be moved
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <ppgso/ppgso.h>
+#include <glm/gtx/euler_angles.hpp>
+
+#include "world.h"
+#include "preview.h"
+
+/*!
+ * Movement of a single asteroid, mimics the Asteroid object from gl9_scene
+ */
+struct Asteroid {
+  size_t instance;
+  glm::dvec3 position, rotation;
+  double scale;
+  glm::dvec3 speed, rotMomentum;
+};
+
+/*!
+ * Generate transformation for an instance from position, rotation and scale
+ */
+glm::dmat4 instanceTransform(const glm::dvec3 &position, const glm::dvec3 &rotation, double scale) {
+  return glm::translate(glm::dmat4{1.0}, position)
+         * glm::orientate4(rotation)
+         * glm::scale(glm::dmat4{1.0}, glm::dvec3{scale});
+}
+
+/*!
+ * Fill the world with an asteroid field and a few reflective sphere clusters
+ * @param world World to fill
+ * @return Asteroids that can be animated
+ */
+std::vector<Asteroid> createScene(World &world) {
+  // Shared geometry
+  auto asteroid = std::make_shared<MeshShape>("asteroid.obj");
+  std::vector<SphereShape::Sphere> cluster;
+  for (int i = 0; i < 32; i++)
+    cluster.push_back({glm::linearRand(0.1, 0.4), glm::ballRand(1.0)});
+  auto spheres = std::make_shared<SphereShape>(cluster);
+
+  // Shared texture
+  auto image = ppgso::image::loadBMP("asteroid.bmp");
+  auto texture = std::make_shared<ppgso::Sampler>(image);
+  world.textures.push_back(texture);
+
+  world.camera = {
+      {  0,   0, 30}, // Position
+      {  0,   0,  1}, // Back
+      {  0,  .5,  0}, // Up
+      { .5,   0,  0}, // Right
+  };
+  world.light = { normalize(glm::dvec3{-1, -1, -1}), {1, 1, 1} };
+  world.ambient = { .1, .1, .1 };
+
+  // Asteroid field
+  std::vector<Asteroid> asteroids;
+  for (int i = 0; i < 10000; i++) {
+    Asteroid a{world.instances.size(),
+               {glm::linearRand(-60.0, 60.0), glm::linearRand(-60.0, 60.0), glm::linearRand(-200.0, 10.0)},
+               glm::ballRand(ppgso::PI), glm::linearRand(1.0, 3.0),
+               {glm::linearRand(-2.0, 2.0), glm::linearRand(-5.0, -10.0), 0.0}, glm::ballRand(ppgso::PI)};
+    Material material{ {0, 0, 0}, glm::dvec3{glm::linearRand(.7, 1.0)}, 0, texture.get() };
+    world.instances.emplace_back(asteroid, instanceTransform(a.position, a.rotation, a.scale), material);
+    asteroids.push_back(a);
+  }
+
+  // Reflective sphere clusters
+  for (int i = 0; i < 20; i++) {
+    glm::dvec3 position{glm::linearRand(-20.0, 20.0), glm::linearRand(-20.0, 20.0), glm::linearRand(-80.0, 0.0)};
+    Material material{ {0, 0, 0}, {.8, .6, .2}, .6 };
+    world.instances.emplace_back(spheres, instanceTransform(position, glm::ballRand(ppgso::PI), 2.0), material);
+  }
+
+  world.build();
+
+  std::cout << "Instances: " << world.instances.size() << std::endl;
+  std::cout << "Shared geometry and textures: " << (asteroid->memoryUsage() + spheres->memoryUsage() + texture->memoryUsage()) / 1024 << " KiB" << std::endl;
+  std::cout << "Instances and top level BVH: " << world.memoryUsage() / 1024 << " KiB" << std::endl;
+
+  return asteroids;
+}
+
+/*!
+ * Move asteroids and update their instances, asteroids leaving the bottom of the field re-enter at the top
+ * @param world World with asteroid instances
+ * @param asteroids Asteroids to animate
+ * @param dt Time step
+ */
+void animate(World &world, std::vector<Asteroid> &asteroids, double dt) {
+  for (auto &a : asteroids) {
+    a.position += a.speed * dt;
+    a.rotation += a.rotMomentum * dt;
+    if (a.position.y < -60) a.position.y += 120;
+    world.instances[a.instance].setTransform(instanceTransform(a.position, a.rotation, a.scale));
+  }
+}
+
+/*!
+ * Measure time of a function call in milliseconds
+ */
+template<typename Function>
+double measure(Function &&function) {
+  auto start = std::chrono::high_resolution_clock::now();
+  function();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/*!
+ * Animate the asteroid field and compare full BVH rebuild with refit for each frame
+ * @param world World to animate
+ * @param asteroids Asteroids to animate
+ */
+void benchmark(World &world, std::vector<Asteroid> &asteroids) {
+  const int frames = 60;
+  const double dt = 1.0 / 30.0;
+
+  // Second copy of the world will be refitted instead of rebuilt
+  World refitted = world;
+  auto refittedAsteroids = asteroids;
+
+  ppgso::ImageRGB32F image{256, 256};
+  double rebuildTime = 0, rebuildRender = 0, refitTime = 0, refitRender = 0;
+  size_t rebuiltInstances = 0;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "frame  rebuild[ms]  render[ms]  SAH cost  refit[ms]  render[ms]  SAH cost  degradation  rebuilt" << std::endl;
+  for (int frame = 0; frame < frames; frame++) {
+    animate(world, asteroids, dt);
+    animate(refitted, refittedAsteroids, dt);
+
+    size_t rebuilt = 0;
+    double build = measure([&] { world.build(); });
+    double buildRender = measure([&] { world.render(image, 1, 2); });
+    double refit = measure([&] { rebuilt = refitted.refit(); });
+    double refitTrace = measure([&] { refitted.render(image, 1, 2); });
+
+    rebuildTime += build;
+    rebuildRender += buildRender;
+    refitTime += refit;
+    refitRender += refitTrace;
+    rebuiltInstances += rebuilt;
+
+    std::cout << std::setw(5) << frame << std::setw(13) << build << std::setw(12) << buildRender << std::setw(10) << world.cost()
+              << std::setw(11) << refit << std::setw(12) << refitTrace << std::setw(10) << refitted.cost()
+              << std::setw(13) << refitted.degradation() << std::setw(9) << rebuilt << std::endl;
+  }
+
+  std::cout << "Average rebuild: " << rebuildTime / frames << " ms, render " << rebuildRender / frames << " ms" << std::endl;
+  std::cout << "Average refit: " << refitTime / frames << " ms, render " << refitRender / frames << " ms" << std::endl;
+  std::cout << "Instances rebuilt during refit: " << rebuiltInstances << std::endl;
+}
+
+/*!
+ * @return True if the output file should be saved as RAW, otherwise BMP is used
+ */
+bool isRaw(const std::string &output) {
+  return output.size() > 4 && output.substr(output.size() - 4) == ".raw";
+}
+
+/*!
+ * Render the world in bands of rows that are written to the output file as soon as they are finished
+ * Only one band is kept in memory so the output resolution is not limited by available memory
+ * @param world World to render
+ * @param width Width of the output image
+ * @param height Height of the output image
+ * @param output Name of the output file, files ending with .raw are saved as RAW, otherwise BMP is used
+ */
+void renderTiled(const World &world, int width, int height, const std::string &output) {
+  const int bandHeight = 64;
+  ppgso::ImageRGB32F hdr{width, bandHeight};
+  ppgso::Image band{width, bandHeight};
+
+  bool raw = isRaw(output);
+  std::unique_ptr<ppgso::image::BMPStream> bmp;
+  std::unique_ptr<ppgso::image::RAWStream> rawStream;
+  if (raw) {
+    rawStream = std::make_unique<ppgso::image::RAWStream>(output, width, height);
+  } else {
+    bmp = std::make_unique<ppgso::image::BMPStream>(output, width, height);
+  }
+
+  for (int y = 0; y < height; y += bandHeight) {
+    // Last band may be smaller, only the top rows of the buffers are used
+    int rows = std::min(bandHeight, height - y);
+    auto hdrView = ppgso::ImageRGB32FView{hdr}.view(0, 0, width, rows);
+    auto bandView = ppgso::ImageView{band}.view(0, 0, width, rows);
+
+    world.render(hdrView, y, height, 1, 3);
+    ppgso::image::toneMap(hdrView, bandView);
+
+    if (raw) {
+      rawStream->write(bandView, y);
+    } else {
+      bmp->write(bandView, y);
+    }
+    std::cout << "\rRendered " << std::min(y + bandHeight, height) << " of " << height << " rows" << std::flush;
+  }
+  // Wait for the last band to be written
+  if (raw) {
+    rawStream->close();
+  } else {
+    bmp->close();
+  }
+  std::cout << std::endl;
+}
+
+/*!
+ * Parse a positive image dimension from a command line argument
+ * @param argument Argument to parse
+ * @param value Parsed value, only set on success
+ * @return True if the whole argument is a number greater than 0 that fits into an int
+ */
+bool parseSize(const char *argument, int &value) {
+  char *end;
+  errno = 0;
+  long number = std::strtol(argument, &end, 10);
+  if (end == argument || *end != '\0' || errno == ERANGE || number <= 0 || number > INT_MAX) return false;
+  value = (int) number;
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  // Check the arguments of tiled rendering before the scene is created
+  bool tiled = argc > 1 && std::string{argv[1]} == "tiled";
+  int width = 0, height = 0;
+  if (tiled && (argc < 5 || !parseSize(argv[2], width) || !parseSize(argv[3], height))) {
+    std::cerr << "Usage: " << argv[0] << " tiled WIDTH HEIGHT FILE, WIDTH and HEIGHT need to be greater than 0" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // Headers of BMP files limit them to 4GB, the RAW format has no such limit
+  if (tiled && !isRaw(argv[4]) && !ppgso::image::BMPStream::fits(width, height)) {
+    std::cerr << width << "x" << height << " pixels do not fit into a BMP file, use a FILE ending with .raw instead" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Make the asteroid field reproducible
+  srand(42);
+
+  // World to render
+  World world;
+  auto asteroids = createScene(world);
+
+  if (argc > 1 && std::string{argv[1]} == "benchmark") {
+    benchmark(world, asteroids);
+    return EXIT_SUCCESS;
+  }
+
+  if (tiled) {
+    renderTiled(world, width, height, argv[4]);
+    std::cout << "Done." << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (argc > 1 && std::string{argv[1]} == "preview") {
+    // Rendering runs on a background thread, the window only displays finished tiles
+    PreviewWindow window{world, 512, 512};
+    while (window.pollEvents()) {}
+    return EXIT_SUCCESS;
+  }
+
+  std::cout << "This will take a while ..." << std::endl;
+
+  // Image to render to
+  ppgso::Image image{512, 512};
+
+  // Render the scene into a float image and convert it at once
+  ppgso::ImageRGB32F hdr{image.width, image.height};
+  world.render(hdr, 4, 3);
+  ppgso::image::toneMap(hdr, image);
+
+  // Save the result
+  ppgso::image::saveBMP(image, "raw5_asteroids.bmp");
+
+  std::cout << "Done." << std::endl;
+  return EXIT_SUCCESS;
+}
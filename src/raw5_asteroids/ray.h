@@ -0,0 +1,93 @@
+#pragma once
+#include <limits>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+// Global constants
+constexpr double INF = std::numeric_limits<double>::max();       // Will be used for infinity
+constexpr double EPS = std::numeric_limits<double>::epsilon();   // Numerical epsilon
+const double DELTA = sqrt(EPS);                                  // Delta to use
+
+/*!
+ * Structure holding origin and direction that represents a ray
+ */
+struct Ray {
+  glm::dvec3 origin, direction;
+
+  /*!
+   * Compute a point on the ray
+   * @param t Distance from origin
+   * @return Point on ray where t is the distance from the origin
+   */
+  inline glm::dvec3 point(double t) const {
+    return origin + direction * t;
+  }
+};
+
+/*!
+ * Ray differentials describe how the ray origin and direction change when moving one pixel on screen
+ * They are used to estimate the footprint of a pixel on surfaces hit by the ray to select a texture level of detail
+ */
+struct RayDifferential {
+  glm::dvec3 dOdx{0, 0, 0}, dOdy{0, 0, 0}, dDdx{0, 0, 0}, dDdy{0, 0, 0};
+
+  /*!
+   * Transfer the differentials to a hit point
+   * @param ray Ray that hit the surface
+   * @param distance Distance to the hit
+   * @param normal Surface normal at the hit
+   * @param dPdx Change of the hit point for one pixel step in x
+   * @param dPdy Change of the hit point for one pixel step in y
+   */
+  inline void transfer(const Ray &ray, double distance, const glm::dvec3 &normal, glm::dvec3 &dPdx, glm::dvec3 &dPdy) const {
+    double dn = dot(ray.direction, normal);
+    if (std::abs(dn) < EPS) dn = dn < 0 ? -EPS : EPS;
+    glm::dvec3 px = dOdx + distance * dDdx;
+    glm::dvec3 py = dOdy + distance * dDdy;
+    dPdx = px - ray.direction * (dot(px, normal) / dn);
+    dPdy = py - ray.direction * (dot(py, normal) / dn);
+  }
+
+  /*!
+   * Differentials of a ray reflected at a hit point, the surface is treated as locally flat
+   * @param normal Surface normal at the hit
+   * @param dPdx Change of the hit point for one pixel step in x
+   * @param dPdy Change of the hit point for one pixel step in y
+   * @return Differentials of the reflected ray
+   */
+  inline RayDifferential reflect(const glm::dvec3 &normal, const glm::dvec3 &dPdx, const glm::dvec3 &dPdy) const {
+    return {dPdx, dPdy, dDdx - 2.0 * dot(dDdx, normal) * normal, dDdy - 2.0 * dot(dDdy, normal) * normal};
+  }
+};
+
+// Textures are sampled using ppgso::Sampler
+namespace ppgso {
+  class Sampler;
+}
+
+/*!
+ * Material coefficients for diffuse, emission and specular reflections
+ * The diffuse color is modulated by an optional texture
+ */
+struct Material {
+  glm::dvec3 emission, diffuse;
+  double reflectivity;
+  const ppgso::Sampler *texture = nullptr;
+};
+
+/*!
+ * Structure to represent a ray to object collision, the Hit structure will contain material surface normal
+ */
+struct Hit {
+  double distance;
+  glm::dvec3 point, normal;
+  glm::dvec2 texCoord;
+  double texCoordDensity; // Change of texture coordinates per world unit
+  Material material;
+};
+
+/*!
+ * Constant for collisions that have not hit any object in the scene
+ */
+const Hit noHit{ INF, {0,0,0}, {0,0,0}, {0,0}, 0, { {0,0,0}, {0,0,0}, 0, nullptr } };
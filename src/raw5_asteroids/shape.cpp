@@ -0,0 +1,173 @@
+#include <sstream>
+
+#include <ppgso/ppgso.h>
+
+#include "shape.h"
+
+MeshShape::MeshShape(const std::string &obj) {
+  // Using tiny obj loader from ppgso lib
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string err = tinyobj::LoadObj(shapes, materials, obj.c_str());
+
+  if (!err.empty() || shapes.empty()) {
+    std::stringstream msg;
+    msg << err << std::endl << "Failed to load OBJ file " << obj << "!" << std::endl;
+    throw std::runtime_error(msg.str());
+  }
+
+  // Will only use the 1st shape
+  auto &mesh = shapes[0].mesh;
+
+  for (size_t i = 0; i < mesh.positions.size() / 3; ++i)
+    positions.emplace_back(mesh.positions[3 * i], mesh.positions[3 * i + 1], mesh.positions[3 * i + 2]);
+
+  for (size_t i = 0; i < mesh.normals.size() / 3; ++i)
+    normals.emplace_back(mesh.normals[3 * i], mesh.normals[3 * i + 1], mesh.normals[3 * i + 2]);
+
+  for (size_t i = 0; i < mesh.texcoords.size() / 2; ++i)
+    texCoords.emplace_back(mesh.texcoords[2 * i], mesh.texcoords[2 * i + 1]);
+
+  indices = mesh.indices;
+
+  // Build BVH over triangles
+  std::vector<AABB> bounds(indices.size() / 3);
+  for (size_t i = 0; i < bounds.size(); i++) {
+    bounds[i].grow(positions[indices[3 * i]]);
+    bounds[i].grow(positions[indices[3 * i + 1]]);
+    bounds[i].grow(positions[indices[3 * i + 2]]);
+  }
+  bvh.build(bounds, 4);
+}
+
+bool MeshShape::intersect(const Ray &ray, uint32_t triangle, double &distance, double &u, double &v) const {
+  const glm::dvec3 &p0 = positions[indices[3 * triangle]];
+  const glm::dvec3 &p1 = positions[indices[3 * triangle + 1]];
+  const glm::dvec3 &p2 = positions[indices[3 * triangle + 2]];
+
+  glm::dvec3 edge1 = p1 - p0;
+  glm::dvec3 edge2 = p2 - p0;
+  glm::dvec3 p = cross(ray.direction, edge2);
+  double det = dot(edge1, p);
+  if (std::abs(det) < EPS) return false;
+
+  double invDet = 1.0 / det;
+  glm::dvec3 s = ray.origin - p0;
+  double bu = dot(s, p) * invDet;
+  if (bu < 0 || bu > 1) return false;
+
+  glm::dvec3 q = cross(s, edge1);
+  double bv = dot(ray.direction, q) * invDet;
+  if (bv < 0 || bu + bv > 1) return false;
+
+  double t = dot(edge2, q) * invDet;
+  if (t <= EPS || t >= distance) return false;
+
+  distance = t;
+  u = bu;
+  v = bv;
+  return true;
+}
+
+bool MeshShape::hit(const Ray &ray, double &maxDistance, ShapeHit &hit) const {
+  uint32_t closest = 0;
+  double u = 0, v = 0;
+  bool found = bvh.traverse(ray, maxDistance, [&](uint32_t triangle, double &distance) {
+    if (!intersect(ray, triangle, distance, u, v)) return false;
+    closest = triangle;
+    return true;
+  });
+  if (!found) return false;
+
+  // Interpolate surface attributes using barycentric coordinates
+  // Note that u and v are from the last accepted hit which is always the closest one
+  uint32_t i0 = indices[3 * closest], i1 = indices[3 * closest + 1], i2 = indices[3 * closest + 2];
+  double w = 1.0 - u - v;
+  if (!normals.empty()) {
+    hit.normal = normalize(normals[i0] * w + normals[i1] * u + normals[i2] * v);
+  } else {
+    hit.normal = normalize(cross(positions[i1] - positions[i0], positions[i2] - positions[i0]));
+  }
+  if (!texCoords.empty()) {
+    hit.texCoord = texCoords[i0] * w + texCoords[i1] * u + texCoords[i2] * v;
+    // Ratio of the triangle area in texture space and local space
+    glm::dvec2 t1 = texCoords[i1] - texCoords[i0], t2 = texCoords[i2] - texCoords[i0];
+    double area = length(cross(positions[i1] - positions[i0], positions[i2] - positions[i0]));
+    hit.texCoordDensity = area > 0 ? sqrt(std::abs(t1.x * t2.y - t1.y * t2.x) / area) : 0;
+  } else {
+    hit.texCoord = {u, v};
+    hit.texCoordDensity = 0;
+  }
+  return true;
+}
+
+bool MeshShape::occluded(const Ray &ray, double maxDistance) const {
+  double u, v;
+  return bvh.traverse(ray, maxDistance, [&](uint32_t triangle, double &distance) {
+    return intersect(ray, triangle, distance, u, v);
+  }, true);
+}
+
+size_t MeshShape::memoryUsage() const {
+  return positions.size() * sizeof(glm::dvec3) + normals.size() * sizeof(glm::dvec3) +
+         texCoords.size() * sizeof(glm::dvec2) + indices.size() * sizeof(uint32_t) + bvh.memoryUsage();
+}
+
+SphereShape::SphereShape(std::vector<Sphere> spheres) : spheres{std::move(spheres)} {
+  // Build BVH over spheres
+  std::vector<AABB> bounds(this->spheres.size());
+  for (size_t i = 0; i < bounds.size(); i++) {
+    auto &sphere = this->spheres[i];
+    bounds[i].grow(sphere.center - sphere.radius);
+    bounds[i].grow(sphere.center + sphere.radius);
+  }
+  bvh.build(bounds, 2);
+}
+
+bool SphereShape::intersect(const Ray &ray, uint32_t sphere, double &distance) const {
+  auto &s = spheres[sphere];
+  glm::dvec3 oc = ray.origin - s.center;
+  double a = dot(ray.direction, ray.direction);
+  double b = dot(oc, ray.direction);
+  double c = dot(oc, oc) - s.radius * s.radius;
+  double dis = b * b - a * c;
+
+  if (dis > 0) {
+    double e = sqrt(dis);
+    double t = (-b - e) / a;
+    if (t <= EPS) t = (-b + e) / a;
+
+    if (t > EPS && t < distance) {
+      distance = t;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SphereShape::hit(const Ray &ray, double &maxDistance, ShapeHit &hit) const {
+  uint32_t closest = 0;
+  bool found = bvh.traverse(ray, maxDistance, [&](uint32_t sphere, double &distance) {
+    if (!intersect(ray, sphere, distance)) return false;
+    closest = sphere;
+    return true;
+  });
+  if (!found) return false;
+
+  // Spherical mapping for texture coordinates
+  auto &sphere = spheres[closest];
+  hit.normal = normalize(ray.point(maxDistance) - sphere.center);
+  hit.texCoord = {0.5 + atan2(hit.normal.z, hit.normal.x) / (2.0 * ppgso::PI), 0.5 - asin(hit.normal.y) / ppgso::PI};
+  hit.texCoordDensity = 1.0 / (sqrt(4.0 * ppgso::PI) * sphere.radius);
+  return true;
+}
+
+bool SphereShape::occluded(const Ray &ray, double maxDistance) const {
+  return bvh.traverse(ray, maxDistance, [&](uint32_t sphere, double &distance) {
+    return intersect(ray, sphere, distance);
+  }, true);
+}
+
+size_t SphereShape::memoryUsage() const {
+  return spheres.size() * sizeof(Sphere) + bvh.memoryUsage();
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ray.h"
+#include "bvh.h"
+
+/*!
+ * Surface information of a ray to shape collision in the local coordinates of the shape
+ */
+struct ShapeHit {
+  glm::dvec3 normal;
+  glm::dvec2 texCoord;
+  double texCoordDensity; // Change of texture coordinates per local unit
+};
+
+/*!
+ * Abstract geometry that can be shared by many instances in the world
+ * Each shape keeps its own bottom level BVH in local coordinates
+ */
+class Shape {
+public:
+  Shape() = default;
+  Shape(const Shape&) = delete;
+  virtual ~Shape() {};
+
+  /*!
+   * @return Bounding box of the shape in local coordinates
+   */
+  AABB bounds() const {
+    return bvh.bounds();
+  }
+
+  /*!
+   * Compute the closest ray to shape collision
+   * @param ray Ray in local coordinates of the shape
+   * @param maxDistance Closest distance found so far, will be updated on hit
+   * @param hit Surface information of the collision, only valid when hit
+   * @return True when the ray hit the shape closer than maxDistance
+   */
+  virtual bool hit(const Ray &ray, double &maxDistance, ShapeHit &hit) const = 0;
+
+  /*!
+   * Check if the ray hits anything closer than maxDistance, used for shadow rays
+   * @param ray Ray in local coordinates of the shape
+   * @param maxDistance Maximal distance to check
+   * @return True when the ray is blocked by the shape
+   */
+  virtual bool occluded(const Ray &ray, double maxDistance) const = 0;
+
+  /*!
+   * @return Memory used by the geometry and its BVH in bytes
+   */
+  virtual size_t memoryUsage() const = 0;
+
+protected:
+  BVH bvh;
+};
+
+/*!
+ * Triangle mesh loaded from a Wavefront obj file
+ */
+class MeshShape final : public Shape {
+private:
+  std::vector<glm::dvec3> positions;
+  std::vector<glm::dvec3> normals;
+  std::vector<glm::dvec2> texCoords;
+  std::vector<uint32_t> indices;
+
+  /*!
+   * Moller-Trumbore ray to triangle intersection
+   * @param ray Ray to test
+   * @param triangle Index of the triangle
+   * @param distance Distance to the hit
+   * @param u First barycentric coordinate of the hit
+   * @param v Second barycentric coordinate of the hit
+   * @return True when the triangle was hit closer than distance
+   */
+  bool intersect(const Ray &ray, uint32_t triangle, double &distance, double &u, double &v) const;
+
+public:
+  /*!
+   * Load the first shape from a Wavefront obj file and build its BVH
+   * @param obj File path to the obj file to load
+   */
+  MeshShape(const std::string &obj);
+
+  bool hit(const Ray &ray, double &maxDistance, ShapeHit &hit) const override;
+  bool occluded(const Ray &ray, double maxDistance) const override;
+  size_t memoryUsage() const override;
+};
+
+/*!
+ * Group of spheres treated as a single shape
+ */
+class SphereShape final : public Shape {
+public:
+  struct Sphere {
+    double radius;
+    glm::dvec3 center;
+  };
+
+  /*!
+   * Create a shape from a set of spheres and build its BVH
+   * @param spheres Spheres that form the shape
+   */
+  SphereShape(std::vector<Sphere> spheres);
+
+  bool hit(const Ray &ray, double &maxDistance, ShapeHit &hit) const override;
+  bool occluded(const Ray &ray, double maxDistance) const override;
+  size_t memoryUsage() const override;
+
+private:
+  std::vector<Sphere> spheres;
+
+  /*!
+   * Compute ray to sphere collision
+   * @param ray Ray to compute collision against
+   * @param sphere Index of the sphere
+   * @param distance Distance to the hit, updated when the sphere is hit closer
+   * @return True when the sphere was hit closer than distance
+   */
+  bool intersect(const Ray &ray, uint32_t sphere, double &distance) const;
+};
@@ -0,0 +1,131 @@
+#include "world.h"
+
+/*!
+ * Compute world space bounding boxes of all instances
+ */
+static std::vector<AABB> instanceBounds(const std::vector<Instance> &instances) {
+  std::vector<AABB> bounds(instances.size());
+  #pragma omp parallel for
+  for (int i = 0; i < (int) instances.size(); i++)
+    bounds[i] = instances[i].bounds();
+  return bounds;
+}
+
+void World::build() {
+  // Instances are large primitives so each gets its own leaf, this also allows partial rebuilds on refit
+  bvh.build(instanceBounds(instances), 1);
+}
+
+size_t World::refit(double threshold) {
+  return bvh.update(instanceBounds(instances), threshold);
+}
+
+Hit World::cast(const Ray &ray) const {
+  double distance = INF;
+  const Instance *closest = nullptr;
+  ShapeHit shapeHit{};
+
+  bvh.traverse(ray, distance, [&](uint32_t index, double &maxDistance) {
+    auto &instance = instances[index];
+    if (!instance.shape->hit(instance.toLocal(ray), maxDistance, shapeHit)) return false;
+    closest = &instance;
+    return true;
+  });
+
+  if (!closest) return noHit;
+
+  // Normals are transformed to world coordinates using the inverse transpose
+  glm::dvec3 normal = normalize(glm::dvec3{transpose(closest->inverse) * glm::dvec4{shapeHit.normal, 0.0}});
+  return {distance, ray.point(distance), normal, shapeHit.texCoord, shapeHit.texCoordDensity / closest->scale, closest->material};
+}
+
+bool World::occluded(const Ray &ray, double maxDistance) const {
+  return bvh.traverse(ray, maxDistance, [&](uint32_t index, double &distance) {
+    auto &instance = instances[index];
+    return instance.shape->occluded(instance.toLocal(ray), distance);
+  }, true);
+}
+
+glm::dvec3 World::trace(const Ray &ray, unsigned int depth) const {
+  return trace(ray, RayDifferential{}, depth);
+}
+
+glm::dvec3 World::trace(const Ray &ray, const RayDifferential &differential, unsigned int depth) const {
+  if (depth == 0) return {0, 0, 0};
+
+  const Hit hit = cast(ray);
+
+  // No hit
+  if (hit.distance >= INF) return {0, 0, 0};
+
+  // Flip normal if we hit the back side of the surface
+  glm::dvec3 normal = dot(ray.direction, hit.normal) < 0 ? hit.normal : -hit.normal;
+
+  // Footprint of the pixel on the surface
+  glm::dvec3 dPdx, dPdy;
+  differential.transfer(ray, hit.distance, normal, dPdx, dPdy);
+
+  // Texture level of detail is selected so one texel covers the pixel footprint
+  glm::dvec3 diffuseColor = hit.material.diffuse;
+  if (hit.material.texture) {
+    double footprint = std::max(length(dPdx), length(dPdy)) * hit.texCoordDensity * hit.material.texture->width();
+    double lod = footprint > 0 ? log2(footprint) : 0;
+    diffuseColor *= glm::dvec3{hit.material.texture->sample(glm::vec2{hit.texCoord}, (float) lod)};
+  }
+
+  // Emission and ambient light
+  glm::dvec3 color = hit.material.emission + diffuseColor * ambient;
+
+  // Diffuse lighting with shadow test
+  Ray lightRay{hit.point + normal * DELTA, -light.direction};
+  double diffuse = dot(normal, lightRay.direction);
+  if (diffuse > 0 && !occluded(lightRay, INF))
+    color += diffuseColor * light.color * diffuse;
+
+  // Blend in ideal specular reflection
+  if (hit.material.reflectivity > 0) {
+    Ray reflectedRay{hit.point + normal * DELTA, reflect(ray.direction, normal)};
+    color = lerp(color, trace(reflectedRay, differential.reflect(normal, dPdx, dPdy), depth - 1), hit.material.reflectivity);
+  }
+
+  return color;
+}
+
+void World::render(const ppgso::ImageRGB32FView &image, unsigned int samples, unsigned int depth) const {
+  render(image, 0, image.height, samples, depth);
+}
+
+void World::render(const ppgso::ImageRGB32FView &band, int y, int height, unsigned int samples, unsigned int depth) const {
+  // Split the band into square tiles that are rendered in parallel
+  const int tileSize = 64;
+  int columns = (band.width + tileSize - 1) / tileSize;
+  int rows = (band.height + tileSize - 1) / tileSize;
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int tile = 0; tile < columns * rows; ++tile) {
+    int tileX = (tile % columns) * tileSize;
+    int tileY = (tile / columns) * tileSize;
+    // Each thread writes directly into its own part of the band
+    auto view = band.view(tileX, tileY, std::min(tileSize, band.width - tileX), std::min(tileSize, band.height - tileY));
+    for (int ty = 0; ty < view.height; ++ty) {
+      for (int tx = 0; tx < view.width; ++tx) {
+        int x = tileX + tx, by = tileY + ty;
+        glm::dvec3 color{};
+
+        // Generate multiple samples
+        for (unsigned int i = 0; i < samples; ++i) {
+          RayDifferential differential;
+          auto ray = camera.generateRay(x, y + by, band.width, height, differential);
+          color = color + trace(ray, differential, depth);
+        }
+        // Collect the data
+        color = color / (double) samples;
+        view.setPixel(tx, ty, glm::vec3{color});
+      }
+    }
+  }
+}
+
+size_t World::memoryUsage() const {
+  return instances.size() * sizeof(Instance) + bvh.memoryUsage();
+}
@@ -0,0 +1,222 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include <ppgso/ppgso.h>
+
+#include "ray.h"
+#include "bvh.h"
+#include "shape.h"
+
+/*!
+ * Structure representing a simple camera that is composed on position, up, back and right vectors
+ */
+struct Camera {
+  glm::dvec3 position, back, up, right;
+
+  /*!
+   * Generate a new Ray for the given viewport size and position
+   * @param x Horizontal position in the viewport
+   * @param y Vertical position in the viewport
+   * @param width Width of the viewport
+   * @param height Height of the viewport
+   * @return Ray for the giver viewport position with small random deviation applied to support multi-sampling
+   */
+  Ray generateRay(int x, int y, int width, int height) const {
+    // Camera deltas
+    glm::dvec3 vdu = 2.0 * right / (double)width;
+    glm::dvec3 vdv = 2.0 * -up / (double)height;
+
+    Ray ray;
+    ray.origin = position;
+    ray.direction = -back
+                  + vdu * ((double)(-width/2 + x) + glm::linearRand(0.0, 1.0))
+                  + vdv * ((double)(-height/2 + y) + glm::linearRand(0.0, 1.0));
+    ray.direction = normalize(ray.direction);
+    return ray;
+  }
+
+  /*!
+   * Generate a new Ray together with its differentials
+   * @param x Horizontal position in the viewport
+   * @param y Vertical position in the viewport
+   * @param width Width of the viewport
+   * @param height Height of the viewport
+   * @param differential Output differentials describing the change of the ray for one pixel step
+   * @return Ray for the giver viewport position with small random deviation applied to support multi-sampling
+   */
+  Ray generateRay(int x, int y, int width, int height, RayDifferential &differential) const {
+    glm::dvec3 vdu = 2.0 * right / (double)width;
+    glm::dvec3 vdv = 2.0 * -up / (double)height;
+
+    glm::dvec3 direction = -back
+                         + vdu * ((double)(-width/2 + x) + glm::linearRand(0.0, 1.0))
+                         + vdv * ((double)(-height/2 + y) + glm::linearRand(0.0, 1.0));
+
+    // Derivative of the normalized direction
+    double dd = dot(direction, direction);
+    double scale = 1.0 / (dd * sqrt(dd));
+    differential.dOdx = differential.dOdy = {0, 0, 0};
+    differential.dDdx = (dd * vdu - dot(direction, vdu) * direction) * scale;
+    differential.dDdy = (dd * vdv - dot(direction, vdv) * direction) * scale;
+
+    return {position, normalize(direction)};
+  }
+};
+
+/*!
+ * Directional light represented by color and direction the light travels in
+ */
+struct Light {
+  glm::dvec3 direction, color;
+};
+
+/*!
+ * Placement of a shared shape in the world
+ * Only the transformation and material are stored per instance, the geometry itself is shared
+ */
+struct Instance {
+  std::shared_ptr<const Shape> shape;
+  glm::dmat4 transform;
+  glm::dmat4 inverse;
+  double scale;
+  Material material;
+
+  /*!
+   * Create new instance of a shape
+   * @param shape Shape to place in the world
+   * @param transform Transformation from shape local coordinates to world coordinates
+   * @param material Material to use for the whole instance
+   */
+  Instance(std::shared_ptr<const Shape> shape, const glm::dmat4 &transform, const Material &material)
+      : shape{std::move(shape)}, material(material) {
+    setTransform(transform);
+  }
+
+  /*!
+   * Move the instance
+   * @param transform New transformation from shape local coordinates to world coordinates
+   */
+  void setTransform(const glm::dmat4 &transform) {
+    this->transform = transform;
+    inverse = glm::inverse(transform);
+    // Average scale of the transformation, used to convert texture coordinate density to world units
+    scale = cbrt(std::abs(glm::determinant(glm::dmat3{transform})));
+  }
+
+  /*!
+   * @return Bounding box of the instance in world coordinates
+   */
+  AABB bounds() const {
+    return shape->bounds().transform(transform);
+  }
+
+  /*!
+   * Transform a world space ray into shape local coordinates
+   * The direction is not normalized so distances along the ray stay the same in both spaces
+   * @param ray Ray in world coordinates
+   * @return Ray in local coordinates
+   */
+  Ray toLocal(const Ray &ray) const {
+    return {glm::dvec3{inverse * glm::dvec4{ray.origin, 1.0}}, glm::dvec3{inverse * glm::dvec4{ray.direction, 0.0}}};
+  }
+};
+
+/*!
+ * Structure to represent the scene/world to render
+ * Instances are organized in a top level BVH, each shape keeps its own bottom level BVH
+ */
+struct World {
+  Camera camera;
+  Light light;
+  glm::dvec3 ambient;
+  std::vector<Instance> instances;
+  // Textures referenced by materials of the instances
+  std::vector<std::shared_ptr<const ppgso::Sampler>> textures;
+
+  /*!
+   * Build the top level BVH over all instances, needs to be called after instances change
+   */
+  void build();
+
+  /*!
+   * Update the top level BVH after instances moved, cheaper than build for animated scenes
+   * Degraded parts of the hierarchy are rebuilt when the SAH cost grows over the threshold
+   * @param threshold Allowed relative growth of the SAH cost, see BVH::update
+   * @return Number of instances that had to be rebuilt
+   */
+  size_t refit(double threshold = 1.25);
+
+  /*!
+   * @return SAH cost of the top level BVH, see BVH::cost
+   */
+  double cost() const {
+    return bvh.cost();
+  }
+
+  /*!
+   * @return SAH cost of the top level BVH relative to the cost after the last full build
+   */
+  double degradation() const {
+    return bvh.degradation();
+  }
+
+  /*!
+   * Compute ray to object collision with any object in the world
+   * @param ray Ray to trace collisions for
+   * @return Hit or noHit structure which indicates the material and distance the ray has collided with
+   */
+  Hit cast(const Ray &ray) const;
+
+  /*!
+   * Check if anything blocks the ray before maxDistance
+   * @param ray Ray to check
+   * @param maxDistance Maximal distance to check
+   * @return True when the ray is blocked
+   */
+  bool occluded(const Ray &ray, double maxDistance) const;
+
+  /*!
+   * Trace a ray as it collides with objects in the world
+   * @param ray Ray to trace
+   * @param depth Maximum number of reflections to trace
+   * @return Color representing the accumulated lighting for each ray collision
+   */
+  glm::dvec3 trace(const Ray &ray, unsigned int depth) const;
+
+  /*!
+   * Trace a ray with differentials used to filter textures on surfaces hit by the ray
+   * @param ray Ray to trace
+   * @param differential Differentials of the ray
+   * @param depth Maximum number of reflections to trace
+   * @return Color representing the accumulated lighting for each ray collision
+   */
+  glm::dvec3 trace(const Ray &ray, const RayDifferential &differential, unsigned int depth) const;
+
+  /*!
+   * Render the world to the provided image
+   * @param image Float image or view to write the colors to
+   * @param samples Number of samples per pixel
+   * @param depth Maximum number of reflections to trace
+   */
+  void render(const ppgso::ImageRGB32FView &image, unsigned int samples, unsigned int depth) const;
+
+  /*!
+   * Render a band of rows of a larger image, used when the whole image does not fit in memory
+   * @param band Float image or view to write the colors to, its width is the width of the whole image
+   * @param y Vertical position of the first row of the band in the whole image
+   * @param height Height of the whole image
+   * @param samples Number of samples per pixel
+   * @param depth Maximum number of reflections to trace
+   */
+  void render(const ppgso::ImageRGB32FView &band, int y, int height, unsigned int samples, unsigned int depth) const;
+
+  /*!
+   * @return Memory used by instances and the top level BVH in bytes
+   */
+  size_t memoryUsage() const;
+
+private:
+  // Top level hierarchy over instances
+  BVH bvh;
+};
@@ -0,0 +1,104 @@
+// Example raw6_codec
+// - Compares uncompressed BMP files with the lossless QOI compression on the textures shipped with the examples
+// - QOI stores each pixel as a run, a reference to a recently seen color, a small difference to the previous pixel or a full color
+// - Every texture is saved and loaded in both formats, the decoded pixels are verified to be identical
+// - Reading the uncompressed bytes of the BMP file is measured as well, the QOI files are smaller but decoding them costs more than copying cached bytes
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include <ppgso/ppgso.h>
+
+// Number of repetitions of each measurement
+const int REPEAT = 20;
+
+/*!
+ * Average time of a function call in milliseconds
+ */
+template<typename Function>
+double measure(Function &&function) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < REPEAT; i++)
+    function();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / REPEAT;
+}
+
+/*!
+ * Size of a file in bytes
+ */
+size_t fileSize(const std::string &file) {
+  std::ifstream stream(file, std::ios::binary | std::ios::ate);
+  return (size_t) stream.tellg();
+}
+
+/*!
+ * Read all bytes of a file, the lower bound of loading any uncompressed format
+ */
+void readFile(const std::string &file, std::vector<char> &bytes) {
+  std::ifstream stream(file, std::ios::binary);
+  bytes.resize(fileSize(file));
+  stream.read(bytes.data(), (std::streamsize) bytes.size());
+}
+
+/*!
+ * Compare pixels of two images
+ */
+bool identical(ppgso::Image &a, ppgso::Image &b) {
+  if (a.width != b.width || a.height != b.height) return false;
+  auto &p = a.getFramebuffer(), &q = b.getFramebuffer();
+  return std::equal(p.begin(), p.end(), q.begin(), [](const ppgso::Image::Pixel &x, const ppgso::Image::Pixel &y) {
+    return x.r == y.r && x.g == y.g && x.b == y.b;
+  });
+}
+
+int main() {
+  const std::string textures[] = {"asteroid.bmp", "corsair.bmp", "explosion.bmp", "lena.bmp", "missile.bmp", "sphere.bmp", "stars.bmp"};
+  const std::string bmp = "raw6_codec.bmp", qoi = "raw6_codec.qoi";
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "texture          BMP[KiB]  QOI[KiB]  ratio  read BMP[ms]  load BMP[ms]  load QOI[ms]  save BMP[ms]  save QOI[ms]"
+            << std::endl;
+
+  bool lossless = true;
+  size_t bmpTotal = 0, qoiTotal = 0;
+  double readTotal = 0, loadBMPTotal = 0, loadQOITotal = 0;
+  std::vector<char> bytes;
+  for (auto &texture : textures) {
+    auto image = ppgso::image::loadBMP(texture);
+
+    double saveBMP = measure([&] { ppgso::image::saveBMP(image, bmp); });
+    double saveQOI = measure([&] { ppgso::image::saveQOI(image, qoi); });
+    double read = measure([&] { readFile(bmp, bytes); });
+    double loadBMP = measure([&] { ppgso::image::loadBMP(bmp); });
+    double loadQOI = measure([&] { ppgso::image::loadQOI(qoi); });
+
+    auto decoded = ppgso::image::loadQOI(qoi);
+    bool equal = identical(image, decoded);
+    lossless &= equal;
+
+    size_t bmpSize = fileSize(bmp), qoiSize = fileSize(qoi);
+    bmpTotal += bmpSize;
+    qoiTotal += qoiSize;
+    readTotal += read;
+    loadBMPTotal += loadBMP;
+    loadQOITotal += loadQOI;
+
+    std::cout << std::setw(14) << std::left << texture << std::right << std::setprecision(1)
+              << std::setw(11) << (double) bmpSize / 1024.0 << std::setw(10) << (double) qoiSize / 1024.0
+              << std::setprecision(2) << std::setw(7) << (double) bmpSize / (double) qoiSize << std::setprecision(3)
+              << std::setw(14) << read << std::setw(14) << loadBMP << std::setw(14) << loadQOI
+              << std::setw(14) << saveBMP << std::setw(14) << saveQOI << (equal ? "" : "  PIXELS DIFFER") << std::endl;
+  }
+
+  std::cout << "Total " << bmpTotal / 1024 << " KiB as BMP, " << qoiTotal / 1024 << " KiB as QOI, ratio "
+            << std::setprecision(2) << (double) bmpTotal / (double) qoiTotal << std::endl;
+  std::cout << std::setprecision(3) << "Reading BMP bytes " << readTotal << " ms, loading BMP " << loadBMPTotal
+            << " ms, loading QOI " << loadQOITotal << " ms" << std::endl;
+  std::cout << (lossless ? "All textures are identical after QOI compression" : "QOI compression changed some textures")
+            << std::endl;
+  return lossless ? EXIT_SUCCESS : EXIT_FAILURE;
+}